@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Минимальный харнесс микробенчмарков: подбирает число итераций так, чтобы
+// замер длился не меньше kMinDuration, печатает наносекунды на операцию и
+// запоминает результат для машиночитаемого отчета (см. results()).
+namespace bench {
+
+constexpr auto kMinDuration = std::chrono::milliseconds(200);
+
+// Не дает компилятору выбросить вычисление результата
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double cpu_ns_per_op;
+};
+
+// Все результаты, полученные в этом процессе
+inline std::vector<Result>& results() {
+    static std::vector<Result> all;
+    return all;
+}
+
+template <typename Fn>
+Result run(const std::string& name, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    uint64_t iterations = 1;
+    while (true) {
+        const auto start = Clock::now();
+        const std::clock_t cpu_start = std::clock();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            fn();
+        }
+        const std::clock_t cpu_end = std::clock();
+        const auto elapsed = Clock::now() - start;
+        if (elapsed >= kMinDuration || iterations >= (uint64_t(1) << 40)) {
+            const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+            const double cpu_ns = 1e9 * static_cast<double>(cpu_end - cpu_start) / CLOCKS_PER_SEC;
+            Result result{name, iterations, ns / static_cast<double>(iterations),
+                          cpu_ns / static_cast<double>(iterations)};
+            std::printf("%-40s %12llu iters %14.1f ns/op\n", name.c_str(),
+                        static_cast<unsigned long long>(iterations), result.ns_per_op);
+            results().push_back(result);
+            return result;
+        }
+        iterations *= 2;
+    }
+}
+
+} // namespace bench
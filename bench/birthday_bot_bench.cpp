@@ -0,0 +1,197 @@
+// Бенчмарки горячих путей бота на синтетических данных.
+//
+//   bench_birthday_bot [--sizes 1000,100000,1000000] [--json results.json]
+//   bench_birthday_bot --generate <dir> <users>
+//
+// JSON-отчет повторяет формат Google Benchmark (context + benchmarks), поэтому
+// результаты двух коммитов можно сравнить его tools/compare.py или просто diff/jq.
+
+#include "bench.h"
+#include "fixtures.h"
+#include "birthday_manager.h"
+#include "gayrate_manager.h"
+#include "responses.h"
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+#ifndef BENCH_REVISION
+#define BENCH_REVISION "unknown"
+#endif
+
+namespace {
+
+void benchBirthdays(const std::string& dir, size_t users) {
+    const std::string path = dir + "/birthdays.json";
+    writeBirthdaysFixture(path, users);
+    const std::string suffix = "/" + std::to_string(users);
+
+    // Первая загрузка импортирует JSON в бинарный снапшот, дальше меряем холодный старт с него
+    { BirthdayManager import(path); }
+    bench::run("loadData/birthdays" + suffix, [&] {
+        BirthdayManager manager(path);
+        bench::doNotOptimize(manager);
+    });
+
+    BirthdayManager manager(path);
+    for (int days : {7, 30, 365}) {
+        bench::run("getUpcomingBirthdays" + suffix + "/" + std::to_string(days), [&] {
+            bench::doNotOptimize(manager.getUpcomingBirthdays(days));
+        });
+    }
+
+    const auto upcoming = manager.getUpcomingBirthdays(30);
+    bench::run("renderDr" + suffix + "/30", [&] {
+        bench::doNotOptimize(renderUpcomingBirthdays(30, upcoming));
+    });
+
+    // Изменение одного пользователя вместе с ожиданием записи на диск
+    std::mt19937 rng(7);
+    bench::run("addBirthday+flush" + suffix, [&] {
+        manager.addBirthday(fixtureNickname(rng() % users), 1 + rng() % 28, 1 + rng() % 12, 1990);
+        manager.flush();
+    });
+}
+
+void benchGayRates(const std::string& dir, size_t users) {
+    const std::string path = dir + "/GayRates.json";
+    writeGayRatesFixture(path, users);
+    const std::string suffix = "/" + std::to_string(users);
+
+    { GayRateManager import(path); }
+    bench::run("loadData/gayrates" + suffix, [&] {
+        GayRateManager manager(path);
+        bench::doNotOptimize(manager);
+    });
+
+    GayRateManager manager(path);
+    bench::run("getTopGayRates" + suffix + "/gayness", [&] {
+        bench::doNotOptimize(manager.getTopGayRates(false));
+    });
+    bench::run("getTopGayRates" + suffix + "/grazd", [&] {
+        bench::doNotOptimize(manager.getTopGayRates(true));
+    });
+    bench::run("getTopGayRates" + suffix + "/gayness/10", [&] {
+        bench::doNotOptimize(manager.getTopGayRates(false, 10));
+    });
+    bench::run("getGayRatesSlice" + suffix + "/middle/50", [&] {
+        bench::doNotOptimize(manager.getGayRatesSlice(false, users / 2, 50));
+    });
+
+    std::mt19937 rank_rng(13);
+    bench::run("getGayRank" + suffix, [&] {
+        bench::doNotOptimize(manager.getGayRank(fixtureNickname(rank_rng() % users), false));
+    });
+
+    std::mt19937 rng(11);
+    bench::run("setGayness+flush" + suffix, [&] {
+        manager.setGayness(fixtureNickname(rng() % users), static_cast<int>(rng() % 100));
+        manager.flush();
+    });
+}
+
+bool writeReport(const std::string& path) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    nlohmann::json report;
+    report["context"] = {
+        {"date", date},
+        {"revision", BENCH_REVISION},
+        {"num_cpus", sysconf(_SC_NPROCESSORS_ONLN)},
+    };
+    report["benchmarks"] = nlohmann::json::array();
+    for (const auto& result : bench::results()) {
+        report["benchmarks"].push_back({
+            {"name", result.name},
+            {"run_type", "iteration"},
+            {"iterations", result.iterations},
+            {"real_time", result.ns_per_op},
+            {"cpu_time", result.cpu_ns_per_op},
+            {"time_unit", "ns"},
+        });
+    }
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << report.dump(2) << '\n';
+    return file.good();
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        sizes.push_back(std::stoul(item));
+    }
+    return sizes;
+}
+
+int usage() {
+    std::cerr << "Usage:\n"
+              << "  bench_birthday_bot [--sizes 1000,100000,1000000] [--json results.json]\n"
+              << "  bench_birthday_bot --generate <dir> <users>\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = {1000, 100000, 1000000};
+    std::string json_path;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--generate" && i + 2 < argc) {
+            const std::string dir = argv[i + 1];
+            const size_t users = std::stoul(argv[i + 2]);
+            const bool ok = writeBirthdaysFixture(dir + "/birthdays.json", users)
+                && writeGayRatesFixture(dir + "/GayRates.json", users);
+            if (!ok) {
+                std::cerr << "Cannot write fixtures to " << dir << std::endl;
+                return 1;
+            }
+            std::cout << "Generated " << users << " users in " << dir << std::endl;
+            return 0;
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            return usage();
+        }
+    }
+
+    char dir_template[] = "/tmp/bench_birthday_bot.XXXXXX";
+    const char* dir = mkdtemp(dir_template);
+    if (!dir) {
+        std::cerr << "Cannot create temporary directory" << std::endl;
+        return 1;
+    }
+
+    for (size_t users : sizes) {
+        const std::string size_dir = std::string(dir) + "/" + std::to_string(users);
+        std::filesystem::create_directories(size_dir);
+        benchBirthdays(size_dir, users);
+        benchGayRates(size_dir, users);
+    }
+    std::filesystem::remove_all(dir);
+
+    if (!json_path.empty() && !writeReport(json_path)) {
+        std::cerr << "Cannot write report to " << json_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
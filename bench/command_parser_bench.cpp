@@ -0,0 +1,71 @@
+// Сравнение разбора аргументов /dr и /add: старый путь через std::regex
+// (регулярка собирается на каждый вызов, как было в обработчиках) и CommandArgs.
+
+#include "bench.h"
+#include "command_parser.h"
+#include "date_utils.h"
+#include <regex>
+#include <string>
+
+namespace {
+
+const std::string kDrText = "/dr 30";
+const std::string kAddText = "/add 15.03.1990";
+const std::string kAddNicknameText = "/add john_smith 25.12.1985";
+
+int regexDr(const std::string& text) {
+    std::regex dr_regex(R"(/dr\s+(\d+))");
+    std::smatch match;
+    if (std::regex_search(text, match, dr_regex)) {
+        return std::stoi(match[1].str());
+    }
+    return 365;
+}
+
+int regexAdd(const std::string& text) {
+    std::regex add_regex(R"(/add\s+(\d{1,2})\.(\d{1,2})\.(\d{4}))");
+    std::smatch match;
+    if (std::regex_search(text, match, add_regex)) {
+        return std::stoi(match[1].str()) + std::stoi(match[2].str()) + std::stoi(match[3].str());
+    }
+    std::regex add_nickname_regex(R"(/add\s+(\w+)\s+(\d{1,2})\.(\d{1,2})\.(\d{4}))");
+    if (std::regex_search(text, match, add_nickname_regex)) {
+        return static_cast<int>(match[1].length()) + std::stoi(match[2].str())
+            + std::stoi(match[3].str()) + std::stoi(match[4].str());
+    }
+    return 0;
+}
+
+int parserDr(const std::string& text) {
+    CommandArgs args(text);
+    if (auto days = parseInt(args.next())) {
+        return *days;
+    }
+    return 365;
+}
+
+int parserAdd(const std::string& text) {
+    CommandArgs args(text);
+    std::string_view first = args.next();
+    std::string_view second = args.next();
+    if (auto date = parseDate(first); date && second.empty()) {
+        return isValidDate(date->day, date->month, date->year) ? date->day + date->month + date->year : 0;
+    }
+    if (auto date = parseDate(second); date && isNickname(first)) {
+        return isValidDate(date->day, date->month, date->year)
+            ? static_cast<int>(first.size()) + date->day + date->month + date->year : 0;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main() {
+    bench::run("regex /dr N", [] { bench::doNotOptimize(regexDr(kDrText)); });
+    bench::run("parser /dr N", [] { bench::doNotOptimize(parserDr(kDrText)); });
+    bench::run("regex /add d.m.y", [] { bench::doNotOptimize(regexAdd(kAddText)); });
+    bench::run("parser /add d.m.y", [] { bench::doNotOptimize(parserAdd(kAddText)); });
+    bench::run("regex /add nick d.m.y", [] { bench::doNotOptimize(regexAdd(kAddNicknameText)); });
+    bench::run("parser /add nick d.m.y", [] { bench::doNotOptimize(parserAdd(kAddNicknameText)); });
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "fixtures.h"
+#include "date_utils.h"
+#include <cstdio>
+#include <random>
+
+namespace {
+
+constexpr char kLetters[] = "abcdefghijklmnopqrstuvwxyz";
+constexpr char kTail[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+
+} // namespace
+
+std::string fixtureNickname(size_t index, uint32_t seed) {
+    std::mt19937 rng(seed ^ static_cast<uint32_t>(index * 2654435761u));
+    std::uniform_int_distribution<int> length(5, 14);
+    std::uniform_int_distribution<int> letter(0, sizeof(kLetters) - 2);
+    std::uniform_int_distribution<int> tail(0, sizeof(kTail) - 2);
+
+    std::string nickname;
+    nickname.push_back(kLetters[letter(rng)]);
+    if (rng() % 3 == 0) {
+        nickname[0] = static_cast<char>(nickname[0] - 'a' + 'A');
+    }
+    for (int i = length(rng); i > 1; --i) {
+        nickname.push_back(kTail[tail(rng)]);
+    }
+    // Суффикс с номером гарантирует уникальность ключей
+    nickname.push_back('_');
+    nickname += std::to_string(index);
+    return nickname;
+}
+
+bool writeBirthdaysFixture(const std::string& path, size_t users, uint32_t seed) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> year(1960, 2010);
+    std::uniform_int_distribution<int> month(1, 12);
+
+    std::fputs("{", file);
+    for (size_t i = 0; i < users; ++i) {
+        const int y = year(rng);
+        const int m = month(rng);
+        const int d = std::uniform_int_distribution<int>(1, daysInMonth(m, y))(rng);
+        std::fprintf(file, "%s\n    \"%s\": {\n        \"day\": %d,\n        \"month\": %d,\n        \"year\": %d\n    }",
+                     i == 0 ? "" : ",", fixtureNickname(i, seed).c_str(), d, m, y);
+    }
+    std::fputs(users == 0 ? "}" : "\n}", file);
+    return std::fclose(file) == 0;
+}
+
+bool writeGayRatesFixture(const std::string& path, size_t users, uint32_t seed) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    std::mt19937 rng(seed + 1);
+    std::uniform_int_distribution<int> score(0, 100);
+
+    std::fputs("{", file);
+    for (size_t i = 0; i < users; ++i) {
+        std::fprintf(file, "%s\n    \"%s\": {\n        \"gayness\": %d,\n        \"grazd\": %d\n    }",
+                     i == 0 ? "" : ",", fixtureNickname(i, seed).c_str(), score(rng), score(rng));
+    }
+    std::fputs(users == 0 ? "}" : "\n}", file);
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Генератор синтетических, но правдоподобных файлов данных бота:
+// никнеймы в формате Telegram username, корректные даты рождения 1960-2010,
+// рейтинги 0-100. Один и тот же seed дает одинаковые файлы.
+
+// birthdays.json: {"nickname": {"day": d, "month": m, "year": y}, ...}
+bool writeBirthdaysFixture(const std::string& path, size_t users, uint32_t seed = 42);
+
+// GayRates.json: {"nickname": {"gayness": g, "grazd": z}, ...}
+bool writeGayRatesFixture(const std::string& path, size_t users, uint32_t seed = 42);
+
+// Никнейм пользователя с номером index (уникален для разных index)
+std::string fixtureNickname(size_t index, uint32_t seed = 42);
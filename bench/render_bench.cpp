@@ -0,0 +1,99 @@
+// Рендеринг ответов: прежний /dr на std::stringstream с localtime/mktime на
+// каждую строку и текущий renderUpcomingBirthdays на fmt::memory_buffer.
+// Ответ /dr на 1000 строк - чат, где все дни рождения попадают в окно.
+
+#include "bench.h"
+#include "fixtures.h"
+#include "responses.h"
+#include <chrono>
+#include <ctime>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string stringstreamDr(int days, const std::vector<std::pair<BirthdayInfo, int>>& upcoming) {
+    if (upcoming.empty()) {
+        return "В ближайшие " + std::to_string(days) + " дней дней рождения не найдено.";
+    }
+
+    std::stringstream response;
+    response << "🎂 Дни рождения в ближайшие " << days << " дней:\n\n";
+
+    for (const auto& [info, age] : upcoming) {
+        auto time_t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::tm current_tm{};
+        localtime_r(&time_t, &current_tm);
+
+        int current_day = current_tm.tm_mday;
+        int current_month = current_tm.tm_mon + 1;
+        int next_birthday_year = current_tm.tm_year + 1900;
+        if (current_month > info.month || (current_month == info.month && current_day > info.day)) {
+            next_birthday_year++;
+        }
+
+        std::tm birthday_tm = {};
+        birthday_tm.tm_year = next_birthday_year - 1900;
+        birthday_tm.tm_mon = info.month - 1;
+        birthday_tm.tm_mday = info.day;
+        auto birthday_time = std::mktime(&birthday_tm);
+        auto current_time = std::mktime(&current_tm);
+        int days_until = (birthday_time - current_time) / (24 * 60 * 60);
+        if (days_until < 0) days_until = 0;
+
+        response << "👤 " << info.nickname << " - " << info.day << "." << info.month;
+        if (current_month == info.month && current_day == info.day) {
+            response << " (СЕГОДНЯ!)";
+        } else if (days_until % 10 == 1) {
+            response << " (через " << days_until << " день)";
+        } else if (days_until % 10 >= 2 && days_until % 10 <= 4) {
+            response << " (через " << days_until << " дня)";
+        } else {
+            response << " (через " << days_until << " дней)";
+        }
+        response << " - исполнится " << age << " лет\n";
+    }
+    return response.str();
+}
+
+// 1000 дней рождения, упорядоченных по дате, как их отдает getUpcomingBirthdays
+std::vector<std::pair<BirthdayInfo, int>> upcomingFixture(size_t rows) {
+    std::mt19937 rng(5);
+    std::vector<std::pair<BirthdayInfo, int>> upcoming;
+    for (size_t i = 0; i < rows; ++i) {
+        const int month = 1 + static_cast<int>(i * 12 / rows);
+        const int year = 1970 + static_cast<int>(rng() % 40);
+        upcoming.push_back({BirthdayInfo(fixtureNickname(i), 1 + static_cast<int>(rng() % 28), month, year),
+                            2025 - year});
+    }
+    return upcoming;
+}
+
+} // namespace
+
+int main() {
+    const auto upcoming = upcomingFixture(1000);
+    const CivilDate today{2025, 1, 1};
+
+    bench::run("renderDr/stringstream/1000", [&] {
+        bench::doNotOptimize(stringstreamDr(365, upcoming));
+    });
+    bench::run("renderDr/fmt/1000", [&] {
+        bench::doNotOptimize(renderUpcomingBirthdays(365, upcoming, today));
+    });
+
+    std::vector<GayRateInfo> top;
+    for (size_t i = 0; i < 100; ++i) {
+        top.emplace_back(fixtureNickname(i), static_cast<int>(100 - i), static_cast<int>(100 - i));
+    }
+    const OwnRank own{"someone", 3, 500, 1000};
+    bench::run("renderRatingTop/100", [&] {
+        bench::doNotOptimize(renderRatingTop(top, false, own));
+    });
+    bench::run("renderGayRoll", [&] {
+        bench::doNotOptimize(renderGayRoll("john_smith", 42));
+    });
+    return 0;
+}
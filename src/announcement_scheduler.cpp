@@ -0,0 +1,74 @@
+#include "announcement_scheduler.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+int64_t unixSeconds(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+
+} // namespace
+
+AnnouncementScheduler::AnnouncementScheduler(ChatSettings& settings, Announce announce,
+                                             size_t batch_size, std::chrono::milliseconds batch_pause)
+    : settings_(settings), announce_(std::move(announce)),
+      batch_size_(std::max<size_t>(batch_size, 1)), batch_pause_(batch_pause) {}
+
+AnnouncementScheduler::~AnnouncementScheduler() {
+    stop();
+}
+
+void AnnouncementScheduler::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    stop_ = false;
+    thread_ = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            lock.unlock();
+            fire();
+            lock.lock();
+            // Следующая граница kCheckInterval от начала эпохи - чья-то полночь
+            const auto now = std::chrono::floor<std::chrono::minutes>(std::chrono::system_clock::now());
+            const auto wake = now - now.time_since_epoch() % kCheckInterval + kCheckInterval;
+            cv_.wait_until(lock, wake, [this] { return stop_; });
+        }
+    });
+}
+
+void AnnouncementScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void AnnouncementScheduler::fire() {
+    // Чаты с отметкой за свой сегодняшний день сюда не попадают - повторный
+    // вызов в тот же день ничего не делает
+    const auto chats = settings_.pendingAnnouncements(unixSeconds(std::chrono::system_clock::now()),
+                                                      localUtcOffset());
+
+    for (size_t i = 0; i < chats.size(); ++i) {
+        if (i > 0 && i % batch_size_ == 0) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (cv_.wait_for(lock, batch_pause_, [this] { return stop_; })) {
+                return; // остаток догонится после перезапуска
+            }
+        }
+        const auto& [chat_id, today] = chats[i];
+        try {
+            announce_(chat_id, today.day, today.month, today.year);
+        } catch (const std::exception& e) {
+            // Чат все равно отмечаем: иначе ошибка в нем повторялась бы каждые 15 минут
+            std::cerr << "Error: Birthday announcement for chat " << chat_id << " failed: " << e.what() << std::endl;
+        }
+        settings_.markAnnounced(chat_id, dateKey(today));
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "chat_settings.h"
+
+// Ежедневная рассылка поздравлений.
+//
+// Поток просыпается каждые kCheckInterval (на границах, кратных ему от начала
+// эпохи, - в них попадает полночь любого реального часового пояса) и
+// поздравляет подписанные чаты, у которых по их часовому поясу наступил день
+// без отметки: для каждого вызывает announce и ставит отметку в ChatSettings. Отметка
+// переживает перезапуск, поэтому рестарт посреди дня не поздравит чат второй
+// раз, а пропущенная из-за простоя рассылка догоняется сразу при старте.
+// Чаты обходятся пачками с паузой между ними: массовая рассылка попадает в
+// очередь отправки порциями и не раздувает ее разом.
+class AnnouncementScheduler {
+public:
+    // Поздравить чат с днями рождения за дату day.month.year
+    using Announce = std::function<void(int64_t chat_id, int day, int month, int year)>;
+
+    AnnouncementScheduler(ChatSettings& settings, Announce announce,
+                          size_t batch_size = 100,
+                          std::chrono::milliseconds batch_pause = std::chrono::seconds(1));
+    ~AnnouncementScheduler();
+
+    AnnouncementScheduler(const AnnouncementScheduler&) = delete;
+    AnnouncementScheduler& operator=(const AnnouncementScheduler&) = delete;
+
+    void start();
+    void stop();
+
+private:
+    // Смещения всех часовых поясов кратны 15 минутам
+    static constexpr std::chrono::minutes kCheckInterval{15};
+
+    ChatSettings& settings_;
+    Announce announce_;
+    size_t batch_size_;
+    std::chrono::milliseconds batch_pause_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    // Поздравить все чаты, которые еще не поздравлены сегодня
+    void fire();
+};
@@ -1,152 +1,274 @@
 #include "birthday_manager.h"
+#include "date_utils.h"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
 
-BirthdayManager::BirthdayManager(const std::string& file_path)
-    : data_file_path_(file_path) {
-    loadData();
-}
+namespace {
 
-void BirthdayManager::loadData() {
-    std::ifstream file(data_file_path_);
-    if (file.is_open()) {
-        try {
-            file >> data_;
-        } catch (const std::exception& e) {
-            std::cerr << "Error loading data: " << e.what() << std::endl;
-            data_ = nlohmann::json::object();
+std::string foldCase(std::string_view text) {
+    std::string folded(text);
+    for (char& c : folded) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
         }
-        file.close();
-    } else {
-        // Создаем пустой JSON объект, если файл не существует
-        data_ = nlohmann::json::object();
     }
+    return folded;
 }
 
-void BirthdayManager::saveData() {
-    std::ofstream file(data_file_path_);
-    if (file.is_open()) {
-        file << data_.dump(4); // Красивое форматирование с отступами
-        file.close();
-    } else {
-        std::cerr << "Error: Cannot save data to file " << data_file_path_ << std::endl;
-    }
-}
+} // namespace
 
-void BirthdayManager::addBirthday(const std::string& nickname, int day, int month, int year) {
-    nlohmann::json user_data;
-    user_data["day"] = day;
-    user_data["month"] = month;
-    user_data["year"] = year;
+BirthdayManager::BirthdayManager(const std::string& file_path)
+    : records_(file_path) {
+    loadData();
+}
 
-    data_[nickname] = user_data;
-    saveData();
+int BirthdayManager::calendarSlot(int day, int month) {
+    // Смещение начала месяца в високосном году
+    static constexpr int kMonthStart[] = {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335};
+    month = std::clamp(month, 1, 12);
+    // Некорректные дни (например, 31.04 из старых данных) прижимаем к концу месяца
+    day = std::clamp(day, 1, daysInMonth(month, 2000));
+    return kMonthStart[month - 1] + day - 1;
 }
 
-std::vector<std::pair<BirthdayInfo, int>> BirthdayManager::getUpcomingBirthdays(int days) {
-    std::vector<std::pair<BirthdayInfo, int>> upcoming;
+int BirthdayManager::nameSlot(std::string_view key) {
+    const char first = key.empty() ? '\0' : key.front();
+    if (first >= 'a' && first <= 'z') {
+        return first - 'a';
+    }
+    if (first >= '0' && first <= '9') {
+        return 26 + (first - '0');
+    }
+    return kNameSlots - 1;
+}
 
-    // Получаем текущую дату
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto tm = *std::localtime(&time_t);
+void BirthdayManager::indexBirthday(Roster& roster, const CalendarEntry& entry) {
+    const int slot = calendarSlot(entry.day, entry.month);
+    // Корзина могла достаться от прошлой версии - меняем копию
+    auto bucket = std::make_shared<Roster::Bucket>(*roster.calendar[slot]);
+    auto it = std::lower_bound(bucket->begin(), bucket->end(), entry.nickname,
+        [](const CalendarEntry& existing, std::string_view nickname) {
+            return existing.nickname < nickname;
+        });
+    bucket->insert(it, entry);
+    roster.calendar[slot] = std::move(bucket);
 
-    int current_day = tm.tm_mday;
-    int current_month = tm.tm_mon + 1; // tm_mon начинается с 0
-    int current_year = tm.tm_year + 1900; // tm_year это годы с 1900
+    NameEntry name{foldCase(entry.nickname), entry};
+    const int name_slot = nameSlot(name.key);
+    auto names = std::make_shared<Roster::NameBucket>(*roster.names[name_slot]);
+    auto pos = std::lower_bound(names->begin(), names->end(), name.key,
+        [](const NameEntry& existing, const std::string& key) { return existing.key < key; });
+    names->insert(pos, std::move(name));
+    roster.names[name_slot] = std::move(names);
+}
 
-    for (auto& [nickname, user_data] : data_.items()) {
-        int day = user_data["day"];
-        int month = user_data["month"];
-        int year = user_data["year"];
+void BirthdayManager::unindexBirthday(Roster& roster, std::string_view nickname, int day, int month) {
+    const int slot = calendarSlot(day, month);
+    auto bucket = std::make_shared<Roster::Bucket>(*roster.calendar[slot]);
+    bucket->erase(std::remove_if(bucket->begin(), bucket->end(),
+        [nickname](const CalendarEntry& entry) { return entry.nickname == nickname; }),
+        bucket->end());
+    roster.calendar[slot] = std::move(bucket);
 
-        BirthdayInfo info(nickname, day, month, year);
+    const std::string key = foldCase(nickname);
+    const int name_slot = nameSlot(key);
+    auto names = std::make_shared<Roster::NameBucket>(*roster.names[name_slot]);
+    names->erase(std::remove_if(names->begin(), names->end(),
+        [nickname](const NameEntry& name) { return name.entry.nickname == nickname; }),
+        names->end());
+    roster.names[name_slot] = std::move(names);
+}
 
-        // Вычисляем возраст и дату следующего дня рождения
-        int age = current_year - year;
-        if (current_month > month || (current_month == month && current_day > day)) {
-            age++;
-        }
+void BirthdayManager::loadData() {
+    // Снапшот (mmap) + журнал; отсутствующие файлы дают пустой список
+    records_.load();
+    publish(buildRoster());
+}
 
-        // Находим дату следующего дня рождения
-        int next_birthday_year = current_year;
-        if (current_month > month || (current_month == month && current_day > day)) {
-            next_birthday_year++;
-        }
+std::shared_ptr<BirthdayManager::Roster> BirthdayManager::buildRoster() const {
+    std::array<Roster::Bucket, kCalendarSlots> buckets;
+    std::array<Roster::NameBucket, kNameSlots> names;
+    const auto& days = records_.column(BirthdaySchema::Day);
+    const auto& months = records_.column(BirthdaySchema::Month);
+    const auto& years = records_.column(BirthdaySchema::Year);
+    for (uint32_t row = 0; row < records_.size(); ++row) {
+        const CalendarEntry entry{records_.nickname(row), years[row],
+                                  static_cast<int16_t>(days[row]), static_cast<int16_t>(months[row])};
+        buckets[calendarSlot(days[row], months[row])].push_back(entry);
+        std::string key = foldCase(entry.nickname);
+        names[nameSlot(key)].push_back(NameEntry{std::move(key), entry});
+    }
 
-        // Вычисляем количество дней до дня рождения
-        std::tm birthday_tm = {};
-        birthday_tm.tm_year = next_birthday_year - 1900;
-        birthday_tm.tm_mon = month - 1;
-        birthday_tm.tm_mday = day;
-        birthday_tm.tm_hour = 0;
-        birthday_tm.tm_min = 0;
-        birthday_tm.tm_sec = 0;
+    auto roster = std::make_shared<Roster>();
+    for (int slot = 0; slot < kCalendarSlots; ++slot) {
+        // После загрузки строки идут по возрастанию никнейма и сортировка ничего
+        // не переставляет; после удалений порядок строк произвольный
+        std::sort(buckets[slot].begin(), buckets[slot].end(),
+                  [](const CalendarEntry& a, const CalendarEntry& b) { return a.nickname < b.nickname; });
+        roster->calendar[slot] = std::make_shared<const Roster::Bucket>(std::move(buckets[slot]));
+    }
+    for (int slot = 0; slot < kNameSlots; ++slot) {
+        // В нижнем регистре порядок может отличаться от порядка строк
+        std::sort(names[slot].begin(), names[slot].end(),
+                  [](const NameEntry& a, const NameEntry& b) { return a.key < b.key; });
+        roster->names[slot] = std::make_shared<const Roster::NameBucket>(std::move(names[slot]));
+    }
+    roster->arena = records_.nameArena();
+    return roster;
+}
 
-        auto birthday_time = std::mktime(&birthday_tm);
-        auto current_time = std::mktime(&tm);
+void BirthdayManager::storeBirthday(Roster& roster, const std::string& nickname,
+                                    const RecordStore<BirthdaySchema>::Values& values) {
+    if (auto row = records_.find(nickname)) {
+        unindexBirthday(roster, nickname, records_.get(*row, BirthdaySchema::Day),
+                        records_.get(*row, BirthdaySchema::Month));
+    }
+    const uint32_t row = records_.put(nickname, values);
+    indexBirthday(roster, CalendarEntry{records_.nickname(row), values[BirthdaySchema::Year],
+                                        static_cast<int16_t>(values[BirthdaySchema::Day]),
+                                        static_cast<int16_t>(values[BirthdaySchema::Month])});
+}
 
-        int days_until_birthday = (birthday_time - current_time) / (24 * 60 * 60);
+void BirthdayManager::addBirthday(const std::string& nickname, int day, int month, int year) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    // Копия версии делит с текущей все корзины, кроме измененных
+    auto roster = std::make_shared<Roster>(*snapshot());
+    storeBirthday(*roster, nickname, {day, month, year});
+    publish(std::move(roster));
+}
 
-        // Если день рождения сегодня, то days_until_birthday = 0
-        if (days_until_birthday < 0) {
-            days_until_birthday = 0;
-        }
+ReloadStats BirthdayManager::replaceAll(std::vector<Record> records) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const auto diff = records_.diff(std::move(records));
+    const auto stats = diff.stats();
+    if (stats.empty()) {
+        return stats;
+    }
 
-        if (days_until_birthday <= days) {
-            upcoming.push_back({info, age});
-        }
+    auto roster = std::make_shared<Roster>(*snapshot());
+    for (const auto& nickname : diff.removed) {
+        const uint32_t row = *records_.find(nickname);
+        // Никнейм в арене переживает удаление строки, календарь ссылается на него до публикации
+        unindexBirthday(*roster, nickname, records_.get(row, BirthdaySchema::Day),
+                        records_.get(row, BirthdaySchema::Month));
+        records_.erase(nickname);
+    }
+    for (const auto& [nickname, values] : diff.upserts) {
+        storeBirthday(*roster, nickname, values);
+    }
+    if (records_.compactNames()) {
+        // Никнеймы переехали в новую арену: версию собираем заново, старая
+        // держит прежнюю арену, пока ее читают
+        roster = buildRoster();
     }
+    publish(std::move(roster));
+    return stats;
+}
 
-    // Сортируем по количеству дней до дня рождения
-    std::sort(upcoming.begin(), upcoming.end(),
-        [](const auto& a, const auto& b) {
-            // Сначала вычисляем дни до дня рождения для каждого
-            auto now = std::chrono::system_clock::now();
-            auto time_t = std::chrono::system_clock::to_time_t(now);
-            auto tm = *std::localtime(&time_t);
+std::vector<std::pair<BirthdayInfo, int>> BirthdayManager::getUpcomingBirthdays(int days) {
+    return getUpcomingBirthdays(days, todayAt(localUtcOffset()));
+}
 
-            int current_day = tm.tm_mday;
-            int current_month = tm.tm_mon + 1;
-            int current_year = tm.tm_year + 1900;
+std::vector<std::pair<BirthdayInfo, int>> BirthdayManager::getUpcomingBirthdays(int days, const CivilDate& today) {
+    std::vector<std::pair<BirthdayInfo, int>> upcoming;
 
-            auto calc_days = [&](const BirthdayInfo& info) {
-                int next_birthday_year = current_year;
-                if (current_month > info.month || (current_month == info.month && current_day > info.day)) {
-                    next_birthday_year++;
-                }
+    int day = today.day;
+    int month = today.month;
+    int year = today.year;
 
-                std::tm birthday_tm = {};
-                birthday_tm.tm_year = next_birthday_year - 1900;
-                birthday_tm.tm_mon = info.month - 1;
-                birthday_tm.tm_mday = info.day;
-                birthday_tm.tm_hour = 0;
-                birthday_tm.tm_min = 0;
-                birthday_tm.tm_sec = 0;
+    const auto roster = snapshot();
 
-                auto birthday_time = std::mktime(&birthday_tm);
-                auto current_time = std::mktime(&tm);
+    // Идем по календарю от сегодняшнего дня и забираем корзины в порядке дат,
+    // поэтому результат уже отсортирован и не требует std::sort.
+    // Каждая корзина попадает в окно не больше одного раза (окно в 365 дней
+    // может захватить сегодняшнюю дату следующего года).
+    std::array<bool, kCalendarSlots> visited{};
+    auto collect = [&](int slot, int birthday_year) {
+        if (visited[slot]) {
+            return;
+        }
+        visited[slot] = true;
+        for (const auto& entry : *roster->calendar[slot]) {
+            upcoming.push_back({BirthdayInfo(std::string(entry.nickname), entry.day, entry.month, entry.year),
+                                birthday_year - entry.year});
+        }
+    };
 
-                return (birthday_time - current_time) / (24 * 60 * 60);
-            };
+    for (int offset = 0; offset <= days; ++offset) {
+        // В невисокосный год 29.02 отмечаем 1 марта
+        if (month == 3 && day == 1 && !isLeapYear(year)) {
+            collect(calendarSlot(29, 2), year);
+        }
+        collect(calendarSlot(day, month), year);
 
-            return calc_days(a.first) < calc_days(b.first);
-        });
+        if (++day > daysInMonth(month, year)) {
+            day = 1;
+            if (++month > 12) {
+                month = 1;
+                ++year;
+            }
+        }
+    }
 
     return upcoming;
 }
 
+std::vector<std::pair<BirthdayInfo, int>> BirthdayManager::getBirthdaysOn(int day, int month, int year) {
+    std::vector<std::pair<BirthdayInfo, int>> birthdays;
+    const auto roster = snapshot();
+    auto collect = [&](int slot) {
+        for (const auto& entry : *roster->calendar[slot]) {
+            birthdays.push_back({BirthdayInfo(std::string(entry.nickname), entry.day, entry.month, entry.year),
+                                 year - entry.year});
+        }
+    };
+    if (month == 3 && day == 1 && !isLeapYear(year)) {
+        collect(calendarSlot(29, 2));
+    }
+    collect(calendarSlot(day, month));
+    return birthdays;
+}
+
+std::vector<BirthdayInfo> BirthdayManager::findByPrefix(std::string_view prefix, size_t limit) const {
+    std::vector<BirthdayInfo> found;
+    const std::string key = foldCase(prefix);
+    const auto roster = snapshot();
+    auto collect = [&](const Roster::NameBucket& bucket) {
+        auto it = std::lower_bound(bucket.begin(), bucket.end(), key,
+            [](const NameEntry& name, const std::string& key) { return name.key < key; });
+        for (; it != bucket.end() && found.size() < limit && it->key.compare(0, key.size(), key) == 0; ++it) {
+            found.emplace_back(std::string(it->entry.nickname), it->entry.day, it->entry.month, it->entry.year);
+        }
+    };
+    if (!key.empty()) {
+        collect(*roster->names[nameSlot(key)]);
+        return found;
+    }
+    // Пустой запрос: первые записи индекса (буквы, затем цифры и остальное)
+    for (const auto& bucket : roster->names) {
+        collect(*bucket);
+    }
+    return found;
+}
+
 bool BirthdayManager::userExists(const std::string& nickname) {
-    return data_.contains(nickname);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return records_.find(nickname).has_value();
 }
 
 BirthdayInfo BirthdayManager::getUserInfo(const std::string& nickname) {
-    if (data_.contains(nickname)) {
-        auto user_data = data_[nickname];
-        return BirthdayInfo(nickname, user_data["day"], user_data["month"], user_data["year"]);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (auto row = records_.find(nickname)) {
+        const auto values = records_.values(*row);
+        return BirthdayInfo(nickname, values[BirthdaySchema::Day], values[BirthdaySchema::Month],
+                            values[BirthdaySchema::Year]);
     }
     return BirthdayInfo("", 0, 0, 0);
 }
+
+void BirthdayManager::flush() {
+    records_.flush();
+}
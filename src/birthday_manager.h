@@ -1,10 +1,16 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <chrono>
-#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string_view>
+#include "date_utils.h"
+#include "record_store.h"
 
 struct BirthdayInfo {
     std::string nickname;
@@ -17,26 +23,99 @@ struct BirthdayInfo {
         : nickname(nick), day(d), month(m), year(y) {}
 };
 
+struct BirthdaySchema {
+    static constexpr std::array<const char*, 3> kFields{"day", "month", "year"};
+    enum Field { Day, Month, Year };
+};
+
 class BirthdayManager {
 private:
-    std::string data_file_path_;
-    nlohmann::json data_;
+    // Календарный индекс: корзина на каждый день года в раскладке високосного года
+    // (29.02 - отдельная корзина 59). Внутри корзины записи упорядочены по никнейму.
+    static constexpr int kCalendarSlots = 366;
+
+    // Запись календаря. Никнейм указывает в арену records_ и действителен,
+    // пока жива версия Roster, в которой лежит запись (она держит арену)
+    struct CalendarEntry {
+        std::string_view nickname;
+        int32_t year;
+        int16_t day;
+        int16_t month;
+    };
+
+    // Индекс никнеймов для поиска по началу: корзина на первый символ
+    // (a-z, 0-9, остальное), внутри - по возрастанию никнейма в нижнем регистре
+    static constexpr int kNameSlots = 37;
+
+    struct NameEntry {
+        std::string key; // никнейм в нижнем регистре (ASCII)
+        CalendarEntry entry;
+    };
+
+    // Неизменяемая версия календаря и индекса никнеймов. Читатели берут ее
+    // через atomic_load без блокировок и работают со своей копией указателя,
+    // сколько бы записей ни прошло параллельно. Писатель собирает новую версию
+    // и публикует ее целиком; нетронутые корзины разделяются между версиями.
+    struct Roster {
+        using Bucket = std::vector<CalendarEntry>;
+        using NameBucket = std::vector<NameEntry>;
+        std::array<std::shared_ptr<const Bucket>, kCalendarSlots> calendar;
+        std::array<std::shared_ptr<const NameBucket>, kNameSlots> names;
+        std::shared_ptr<const void> arena; // арена никнеймов, на которую ссылаются записи
+    };
+
+    // Сериализует писателей и защищает records_; читатели календаря мьютекс не берут
+    std::mutex write_mutex_;
+    RecordStore<BirthdaySchema> records_;
+    std::shared_ptr<const Roster> roster_;
 
     void loadData();
-    void saveData();
+    std::shared_ptr<Roster> buildRoster() const;
+
+    std::shared_ptr<const Roster> snapshot() const { return std::atomic_load(&roster_); }
+    void publish(std::shared_ptr<const Roster> roster) { std::atomic_store(&roster_, std::move(roster)); }
+
+    static int calendarSlot(int day, int month);
+    static int nameSlot(std::string_view key);
+    static void indexBirthday(Roster& roster, const CalendarEntry& entry);
+    static void unindexBirthday(Roster& roster, std::string_view nickname, int day, int month);
+    void storeBirthday(Roster& roster, const std::string& nickname, const RecordStore<BirthdaySchema>::Values& values);
 
 public:
+    using Record = RecordStore<BirthdaySchema>::Record;
+
     BirthdayManager(const std::string& file_path = "birthdays.json");
 
     // Добавить день рождения пользователя
     void addBirthday(const std::string& nickname, int day, int month, int year);
 
-    // Получить ближайшие дни рождения в течение N дней
+    // Привести данные к полному списку records (JSON-файл, исправленный
+    // снаружи): меняются и попадают в журнал только отличающиеся записи,
+    // корзины календаря обновляются точечно, читатели видят все изменения
+    // одной новой версией
+    ReloadStats replaceAll(std::vector<Record> records);
+
+    // Получить ближайшие дни рождения в течение N дней (от сегодняшней даты сервера)
     std::vector<std::pair<BirthdayInfo, int>> getUpcomingBirthdays(int days = 365);
 
+    // То же от даты today - "сегодня" в часовом поясе чата
+    std::vector<std::pair<BirthdayInfo, int>> getUpcomingBirthdays(int days, const CivilDate& today);
+
+    // Дни рождения, которые празднуются в день day.month.year, с возрастом
+    // (в невисокосный год 1 марта сюда попадают и родившиеся 29.02)
+    std::vector<std::pair<BirthdayInfo, int>> getBirthdaysOn(int day, int month, int year);
+
+    // До limit записей, никнейм которых начинается с prefix (без учета
+    // регистра латиницы), по алфавиту. Не берет мьютекс и не перебирает всех
+    // пользователей: поиск делением пополам в корзине первого символа
+    std::vector<BirthdayInfo> findByPrefix(std::string_view prefix, size_t limit) const;
+
     // Проверить, существует ли пользователь
     bool userExists(const std::string& nickname);
 
     // Получить информацию о пользователе
     BirthdayInfo getUserInfo(const std::string& nickname);
+
+    // Дождаться, пока все изменения окажутся на диске
+    void flush();
 };
@@ -0,0 +1,84 @@
+#include "chat_settings.h"
+#include <charconv>
+
+ChatSettings::ChatSettings(const std::string& file_path)
+    : records_(file_path) {
+    records_.load();
+}
+
+RecordStore<ChatSettingsSchema>::Values ChatSettings::valuesOf(const std::string& key) const {
+    if (auto row = records_.find(key)) {
+        return records_.values(*row);
+    }
+    return {};
+}
+
+void ChatSettings::setSubscribed(int64_t chat_id, bool subscribed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string key = std::to_string(chat_id);
+    auto values = valuesOf(key);
+    values[ChatSettingsSchema::Subscribed] = subscribed ? 1 : 0;
+    records_.put(key, values);
+}
+
+bool ChatSettings::isSubscribed(int64_t chat_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return valuesOf(std::to_string(chat_id))[ChatSettingsSchema::Subscribed] != 0;
+}
+
+void ChatSettings::setUtcOffset(int64_t chat_id, std::optional<std::chrono::minutes> offset) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string key = std::to_string(chat_id);
+    auto values = valuesOf(key);
+    values[ChatSettingsSchema::HasTz] = offset ? 1 : 0;
+    values[ChatSettingsSchema::UtcOffset] = offset ? static_cast<int32_t>(offset->count()) : 0;
+    records_.put(key, values);
+}
+
+std::optional<std::chrono::minutes> ChatSettings::utcOffset(int64_t chat_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto values = valuesOf(std::to_string(chat_id));
+    if (values[ChatSettingsSchema::HasTz] == 0) {
+        return std::nullopt;
+    }
+    return std::chrono::minutes(values[ChatSettingsSchema::UtcOffset]);
+}
+
+std::vector<ChatSettings::PendingAnnouncement> ChatSettings::pendingAnnouncements(
+        int64_t unix_seconds, std::chrono::minutes default_offset) {
+    std::vector<PendingAnnouncement> chats;
+    // Дата в поясе сервера одна на все чаты без своего пояса
+    const CivilDate default_today = civilDateAt(unix_seconds, static_cast<int>(default_offset.count()));
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto& subscribed = records_.column(ChatSettingsSchema::Subscribed);
+    const auto& announced = records_.column(ChatSettingsSchema::Announced);
+    const auto& has_tz = records_.column(ChatSettingsSchema::HasTz);
+    const auto& utc_offset = records_.column(ChatSettingsSchema::UtcOffset);
+    for (uint32_t row = 0; row < records_.size(); ++row) {
+        if (subscribed[row] == 0) {
+            continue;
+        }
+        const CivilDate today = has_tz[row] != 0 ? civilDateAt(unix_seconds, utc_offset[row]) : default_today;
+        if (announced[row] >= dateKey(today)) {
+            continue;
+        }
+        const std::string_view key = records_.nickname(row);
+        int64_t chat_id = 0;
+        if (std::from_chars(key.data(), key.data() + key.size(), chat_id).ec == std::errc()) {
+            chats.push_back(PendingAnnouncement{chat_id, today});
+        }
+    }
+    return chats;
+}
+
+void ChatSettings::markAnnounced(int64_t chat_id, int32_t date_key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string key = std::to_string(chat_id);
+    auto values = valuesOf(key);
+    values[ChatSettingsSchema::Announced] = date_key;
+    records_.put(key, values);
+}
+
+void ChatSettings::flush() {
+    records_.flush();
+}
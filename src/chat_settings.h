@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "date_utils.h"
+#include "record_store.h"
+
+struct ChatSettingsSchema {
+    static constexpr std::array<const char*, 4> kFields{"subscribed", "announced", "has_tz", "utc_offset"};
+    enum Field { Subscribed, Announced, HasTz, UtcOffset };
+};
+
+// Настройки чатов: подписка на ежедневные поздравления, отметка о последнем
+// поздравлении (дата в виде ГГГГММДД), чтобы после перезапуска не поздравить
+// чат второй раз за день, и часовой пояс чата (смещение от UTC в минутах;
+// без него - пояс сервера). Ключ записи - id чата.
+class ChatSettings {
+public:
+    struct PendingAnnouncement {
+        int64_t chat_id;
+        CivilDate date; // "сегодня" в часовом поясе чата
+    };
+
+    explicit ChatSettings(const std::string& file_path = "chats.json");
+
+    void setSubscribed(int64_t chat_id, bool subscribed);
+    bool isSubscribed(int64_t chat_id);
+
+    // Часовой пояс чата; nullopt - пояс сервера
+    void setUtcOffset(int64_t chat_id, std::optional<std::chrono::minutes> offset);
+    std::optional<std::chrono::minutes> utcOffset(int64_t chat_id);
+
+    // Подписанные чаты, которые еще не поздравлены в свой сегодняшний день на
+    // момент unix_seconds. default_offset - пояс чатов без своего
+    std::vector<PendingAnnouncement> pendingAnnouncements(int64_t unix_seconds, std::chrono::minutes default_offset);
+
+    // Отметить, что чат поздравлен в день date_key
+    void markAnnounced(int64_t chat_id, int32_t date_key);
+
+    // Дождаться, пока все изменения окажутся на диске
+    void flush();
+
+private:
+    std::mutex mutex_;
+    RecordStore<ChatSettingsSchema> records_;
+
+    RecordStore<ChatSettingsSchema>::Values valuesOf(const std::string& key) const;
+};
@@ -0,0 +1,46 @@
+#include "chat_shards.h"
+#include "journal_store.h"
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+std::string chatShardPath(const std::string& dir, int64_t chat_id) {
+    return dir + "/" + std::to_string(chat_id) + ".json";
+}
+
+void createShardDir(const std::string& dir) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Error: Cannot create directory " << dir << ": " << ec.message() << std::endl;
+    }
+}
+
+bool migrateLegacyStore(const std::string& legacy_path, const std::string& shard_path) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::exists(legacy_path, ec) && !fs::exists(legacy_path + ".journal", ec)) {
+        return false;
+    }
+    const std::string base = storeBasePath(shard_path);
+    if (fs::exists(shard_path, ec) || fs::exists(base + ".snap", ec) || fs::exists(base + ".journal", ec)) {
+        std::cerr << "Warning: " << shard_path << " already exists, " << legacy_path
+                  << " is left untouched" << std::endl;
+        return false;
+    }
+
+    // Переносим JSON и его журналы как есть: JournalStore импортирует их при загрузке шарда
+    for (const char* suffix : {".journal.compacting", ".journal", ""}) {
+        const std::string from = legacy_path + suffix;
+        if (!fs::exists(from, ec)) {
+            continue;
+        }
+        fs::rename(from, shard_path + suffix, ec);
+        if (ec) {
+            std::cerr << "Error: Cannot move " << from << " to " << shard_path << suffix
+                      << ": " << ec.message() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Путь к файлу шарда чата: <dir>/<chatId>.json
+std::string chatShardPath(const std::string& dir, int64_t chat_id);
+
+// Создать каталог шардов, если его нет
+void createShardDir(const std::string& dir);
+
+// Перенести данные из общего файла старых версий (снапшот и журнал) в шард
+// чата, если у чата еще нет своего файла. false - переносить нечего или не вышло
+bool migrateLegacyStore(const std::string& legacy_path, const std::string& shard_path);
+
+// Хранилища, разбитые по чатам.
+//
+// У каждого чата свой экземпляр Shard (менеджер со своим мьютексом и своим
+// файлом), поэтому запись в одном чате не блокирует и не переписывает данные
+// других. Каталог шардов разбит на kStripes полос со своими мьютексами: поиск
+// шарда берет только мьютекс своей полосы, и только на время поиска.
+// Шарды создаются при первом обращении и живут до конца работы бота, поэтому
+// ссылку из get можно использовать без блокировки каталога.
+template <typename Shard>
+class ChatShards {
+public:
+    explicit ChatShards(std::string dir) : dir_(std::move(dir)) {
+        createShardDir(dir_);
+    }
+
+    ChatShards(const ChatShards&) = delete;
+    ChatShards& operator=(const ChatShards&) = delete;
+
+    Shard& get(int64_t chat_id) {
+        auto& stripe = stripeFor(chat_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto& shard = stripe.shards[chat_id];
+        if (!shard) {
+            // Загрузка идет под мьютексом полосы: два потока не откроют один файл дважды
+            shard = std::make_unique<Shard>(chatShardPath(dir_, chat_id));
+        }
+        return *shard;
+    }
+
+    // Количество загруженных шардов
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& stripe : stripes_) {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            total += stripe.shards.size();
+        }
+        return total;
+    }
+
+    const std::string& dir() const { return dir_; }
+
+private:
+    static constexpr size_t kStripes = 64;
+
+    struct Stripe {
+        mutable std::mutex mutex;
+        std::unordered_map<int64_t, std::unique_ptr<Shard>> shards;
+    };
+
+    std::string dir_;
+    std::array<Stripe, kStripes> stripes_;
+
+    Stripe& stripeFor(int64_t chat_id) {
+        // id групп идут подряд, поэтому перемешиваем биты (Fibonacci hashing)
+        const uint64_t hash = static_cast<uint64_t>(chat_id) * 0x9E3779B97F4A7C15ull;
+        return stripes_[(hash >> 32) % kStripes];
+    }
+};
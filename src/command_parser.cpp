@@ -0,0 +1,138 @@
+#include "command_parser.h"
+#include <limits>
+
+namespace {
+
+constexpr bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+constexpr bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+std::string_view skipSpaces(std::string_view text) {
+    size_t pos = 0;
+    while (pos < text.size() && isSpace(text[pos])) {
+        ++pos;
+    }
+    return text.substr(pos);
+}
+
+// Число из 1..max_digits цифр (вся строка должна состоять из цифр)
+std::optional<int> parseDigits(std::string_view token, size_t min_digits, size_t max_digits) {
+    if (token.size() < min_digits || token.size() > max_digits) {
+        return std::nullopt;
+    }
+    return parseInt(token);
+}
+
+} // namespace
+
+CommandArgs::CommandArgs(std::string_view text) : rest_(skipSpaces(text)) {
+    // Пропускаем саму команду вместе с возможным @имя_бота
+    if (!rest_.empty() && rest_.front() == '/') {
+        next();
+    }
+}
+
+std::string_view CommandArgs::next() {
+    size_t end = 0;
+    while (end < rest_.size() && !isSpace(rest_[end])) {
+        ++end;
+    }
+    std::string_view token = rest_.substr(0, end);
+    rest_ = skipSpaces(rest_.substr(end));
+    return token;
+}
+
+std::string_view commandName(std::string_view text) {
+    text = skipSpaces(text);
+    if (text.empty() || text.front() != '/') {
+        return {};
+    }
+    size_t end = 1;
+    while (end < text.size() && !isSpace(text[end]) && text[end] != '@') {
+        ++end;
+    }
+    return text.substr(1, end - 1);
+}
+
+std::optional<int> parseInt(std::string_view token) {
+    if (token.empty()) {
+        return std::nullopt;
+    }
+    int value = 0;
+    for (char c : token) {
+        if (!isDigit(c)) {
+            return std::nullopt;
+        }
+        const int digit = c - '0';
+        if (value > (std::numeric_limits<int>::max() - digit) / 10) {
+            return std::nullopt;
+        }
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+std::optional<ParsedDate> parseDate(std::string_view token) {
+    const size_t first_dot = token.find('.');
+    if (first_dot == std::string_view::npos) {
+        return std::nullopt;
+    }
+    const size_t second_dot = token.find('.', first_dot + 1);
+    if (second_dot == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    auto day = parseDigits(token.substr(0, first_dot), 1, 2);
+    auto month = parseDigits(token.substr(first_dot + 1, second_dot - first_dot - 1), 1, 2);
+    auto year = parseDigits(token.substr(second_dot + 1), 4, 4);
+    if (!day || !month || !year) {
+        return std::nullopt;
+    }
+    return ParsedDate{*day, *month, *year};
+}
+
+std::optional<int> parseUtcOffset(std::string_view token) {
+    for (std::string_view prefix : {"UTC", "utc", "GMT", "gmt"}) {
+        if (token.substr(0, prefix.size()) == prefix) {
+            token.remove_prefix(prefix.size());
+            break;
+        }
+    }
+    int sign = 1;
+    if (!token.empty() && (token.front() == '+' || token.front() == '-')) {
+        sign = token.front() == '-' ? -1 : 1;
+        token.remove_prefix(1);
+    }
+
+    const size_t colon = token.find(':');
+    auto hours = parseDigits(token.substr(0, colon), 1, 2);
+    if (!hours) {
+        return std::nullopt;
+    }
+    int minutes = 0;
+    if (colon != std::string_view::npos) {
+        auto parsed = parseDigits(token.substr(colon + 1), 2, 2);
+        if (!parsed || *parsed >= 60) {
+            return std::nullopt;
+        }
+        minutes = *parsed;
+    }
+    return sign * (*hours * 60 + minutes);
+}
+
+bool isNickname(std::string_view token) {
+    if (token.empty()) {
+        return false;
+    }
+    for (char c : token) {
+        const bool word = isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        if (!word) {
+            return false;
+        }
+    }
+    return true;
+}
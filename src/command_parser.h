@@ -0,0 +1,46 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+// Разбор аргументов команд без regex и без выделений памяти:
+// все функции работают со string_view поверх текста сообщения.
+
+struct ParsedDate {
+    int day;
+    int month;
+    int year;
+};
+
+// Токены после имени команды ("/dr 30", "/dr@bot_name 30" -> "30")
+class CommandArgs {
+public:
+    explicit CommandArgs(std::string_view text);
+
+    // Следующий токен или пустой string_view, если аргументы закончились
+    std::string_view next();
+
+    bool empty() const { return rest_.empty(); }
+
+private:
+    std::string_view rest_;
+};
+
+// Имя команды без '/' и @имя_бота ("/dr@bot_name 30" -> "dr"); пустой
+// string_view - текст не команда
+std::string_view commandName(std::string_view text);
+
+// Неотрицательное целое из десятичных цифр (без знака и переполнения)
+std::optional<int> parseInt(std::string_view token);
+
+// Дата в формате d.m.yyyy / dd.mm.yyyy. Проверяется только формат,
+// существование даты - isValidDate из date_utils.h
+std::optional<ParsedDate> parseDate(std::string_view token);
+
+// Смещение от UTC в минутах: "+3", "-5", "3", "+5:30", "UTC+3", "GMT-03:30".
+// Проверяется только формат, допустимый диапазон - kMinUtcOffsetMinutes и
+// kMaxUtcOffsetMinutes из date_utils.h
+std::optional<int> parseUtcOffset(std::string_view token);
+
+// Никнейм: латинские буквы, цифры и '_'
+bool isNickname(std::string_view token);
@@ -0,0 +1,84 @@
+#include "command_router.h"
+#include <iterator>
+
+SlidingWindowLimiter::SlidingWindowLimiter(uint32_t limit, Clock::duration window)
+    : limit_(limit), window_(window) {}
+
+SlidingWindowLimiter::Window& SlidingWindowLimiter::slide(int64_t key, Clock::time_point now) {
+    auto [it, inserted] = windows_.try_emplace(key);
+    Window& window = it->second;
+    if (inserted) {
+        window.start = now;
+        return window;
+    }
+    const auto elapsed = now - window.start;
+    if (elapsed >= 2 * window_) {
+        // Оба окна в прошлом
+        window = Window{now};
+    } else if (elapsed >= window_) {
+        window.previous = window.current;
+        window.current = 0;
+        window.start += window_;
+    }
+    return window;
+}
+
+double SlidingWindowLimiter::estimate(const Window& window, Clock::time_point now) const {
+    const double passed = std::chrono::duration<double>(now - window.start) / window_;
+    const double overlap = passed < 1.0 ? 1.0 - passed : 0.0;
+    return window.previous * overlap + window.current;
+}
+
+bool SlidingWindowLimiter::allows(int64_t key, uint32_t cost, Clock::time_point now) {
+    return estimate(slide(key, now), now) + cost <= limit_;
+}
+
+void SlidingWindowLimiter::charge(int64_t key, uint32_t cost, Clock::time_point now) {
+    slide(key, now).current += cost;
+}
+
+void SlidingWindowLimiter::evictIdle(Clock::time_point now) {
+    for (auto it = windows_.begin(); it != windows_.end();) {
+        if (now - it->second.start >= 2 * window_) {
+            it = windows_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+FloodGuard::FloodGuard(const Config& config)
+    : users_(config.userLimit, config.userWindow), chats_(config.chatLimit, config.chatWindow) {}
+
+FloodVerdict FloodGuard::check(int64_t userId, int64_t chatId, uint32_t cost, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (++checks_ % kEvictEvery == 0) {
+        users_.evictIdle(now);
+        chats_.evictIdle(now);
+        for (auto it = notified_.begin(); it != notified_.end();) {
+            it = now - it->second >= users_.window() ? notified_.erase(it) : std::next(it);
+        }
+    }
+
+    if (!users_.allows(userId, cost, now)) {
+        // Отброшенные команды не продлевают окно: пользователь, который
+        // перестал спамить, снова может писать через userWindow
+        auto [it, inserted] = notified_.try_emplace(userId, now);
+        if (inserted || now - it->second >= users_.window()) {
+            it->second = now;
+            return FloodVerdict::Notify;
+        }
+        return FloodVerdict::Drop;
+    }
+    if (!chats_.allows(chatId, cost, now)) {
+        return FloodVerdict::Drop;
+    }
+    users_.charge(userId, cost, now);
+    chats_.charge(chatId, cost, now);
+    return FloodVerdict::Allow;
+}
+
+size_t FloodGuard::trackedKeys() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return users_.size() + chats_.size();
+}
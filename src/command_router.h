@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+// Строка таблицы команд: имя без '/', обработчик и стоимость для лимитов
+// (тяжелые команды вроде /dr расходуют окно быстрее)
+template <typename Handler>
+struct CommandRoute {
+    std::string_view name;
+    Handler handler;
+    uint32_t cost = 1;
+};
+
+// Таблица упорядочена по имени без повторов - проверяется static_assert там,
+// где она объявлена, и дает поиск делением пополам
+template <typename Handler, size_t N>
+constexpr bool isSortedRouteTable(const std::array<CommandRoute<Handler>, N>& table) {
+    for (size_t i = 1; i < N; ++i) {
+        if (!(table[i - 1].name < table[i].name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Номер строки с командой name или N, если такой команды нет
+template <typename Handler, size_t N>
+constexpr size_t findRoute(const std::array<CommandRoute<Handler>, N>& table, std::string_view name) {
+    size_t low = 0;
+    size_t high = N;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (table[middle].name < name) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < N && table[low].name == name ? low : N;
+}
+
+// Скользящее окно на ключ: запросы текущего окна плюс доля предыдущего,
+// пропорциональная тому, насколько окно уже сдвинулось. Два счетчика на ключ
+// вместо журнала отметок времени; всплеск на стыке окон не проходит, как в
+// фиксированном окне.
+//
+// Не потокобезопасен: владелец (FloodGuard) вызывает его под своим мьютексом.
+class SlidingWindowLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SlidingWindowLimiter(uint32_t limit, Clock::duration window);
+
+    // Поместится ли запрос стоимостью cost в окно ключа
+    bool allows(int64_t key, uint32_t cost, Clock::time_point now);
+
+    // Учесть запрос
+    void charge(int64_t key, uint32_t cost, Clock::time_point now);
+
+    // Удалить ключи, которые не обращались дольше двух окон
+    void evictIdle(Clock::time_point now);
+
+    size_t size() const { return windows_.size(); }
+    Clock::duration window() const { return window_; }
+
+private:
+    struct Window {
+        Clock::time_point start;
+        uint32_t previous = 0;
+        uint32_t current = 0;
+    };
+
+    const uint32_t limit_;
+    const Clock::duration window_;
+    std::unordered_map<int64_t, Window> windows_;
+
+    Window& slide(int64_t key, Clock::time_point now);
+    double estimate(const Window& window, Clock::time_point now) const;
+};
+
+enum class FloodVerdict {
+    Allow,  // выполнить команду
+    Notify, // отбросить и один раз за окно ответить, что пользователь спамит
+    Drop,   // отбросить молча
+};
+
+// Лимиты входящих команд на пользователя и на чат. Проверка идет до очереди
+// обработчиков: отброшенная команда не занимает поток, не трогает хранилище и
+// ничего не ставит в очередь отправки. Превышение лимита пользователя дает
+// одно уведомление за окно, остальное отбрасывается молча; превышение лимита
+// чата (спамят многие) - только молча, чтобы не тратить лимит отправки.
+class FloodGuard {
+public:
+    using Clock = SlidingWindowLimiter::Clock;
+
+    struct Config {
+        uint32_t userLimit = 6;                  // стоимость команд одного пользователя
+        Clock::duration userWindow = std::chrono::seconds(30);
+        uint32_t chatLimit = 20;                 // около лимита Telegram на отправку в группу
+        Clock::duration chatWindow = std::chrono::seconds(60);
+    };
+
+    FloodGuard() : FloodGuard(Config{}) {}
+    explicit FloodGuard(const Config& config);
+
+    FloodVerdict check(int64_t userId, int64_t chatId, uint32_t cost, Clock::time_point now);
+
+    // Ключей с состоянием (для метрик)
+    size_t trackedKeys() const;
+
+private:
+    // Раз в столько проверок удаляются ключи без обращений
+    static constexpr uint32_t kEvictEvery = 1024;
+
+    mutable std::mutex mutex_;
+    SlidingWindowLimiter users_;
+    SlidingWindowLimiter chats_;
+    std::unordered_map<int64_t, Clock::time_point> notified_; // пользователь -> когда уведомлен
+    uint32_t checks_ = 0;
+};
@@ -0,0 +1,160 @@
+#include "data_watcher.h"
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+namespace {
+
+// chatId из имени "<chatId>.json"
+std::optional<int64_t> shardChatId(std::string_view name) {
+    constexpr std::string_view suffix = ".json";
+    if (name.size() <= suffix.size() || name.substr(name.size() - suffix.size()) != suffix) {
+        return std::nullopt;
+    }
+    int64_t chat_id = 0;
+    const char* end = name.data() + name.size() - suffix.size();
+    auto [ptr, ec] = std::from_chars(name.data(), end, chat_id);
+    if (ec != std::errc() || ptr != end) {
+        return std::nullopt;
+    }
+    return chat_id;
+}
+
+void closeFd(int& fd) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+} // namespace
+
+#endif
+
+DataWatcher::DataWatcher(std::vector<std::string> dirs, Callback onChange)
+    : dirs_(std::move(dirs)), onChange_(std::move(onChange)) {}
+
+DataWatcher::~DataWatcher() {
+    stop();
+}
+
+#ifdef __linux__
+
+void DataWatcher::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0 || ::pipe2(stop_pipe_, O_CLOEXEC) != 0) {
+        std::cerr << "Error: Cannot watch data files: " << std::strerror(errno) << std::endl;
+        stop();
+        return;
+    }
+    watches_.clear();
+    for (const auto& dir : dirs_) {
+        const int wd = ::inotify_add_watch(inotify_fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            std::cerr << "Error: Cannot watch " << dir << ": " << std::strerror(errno) << std::endl;
+        }
+        watches_.push_back(wd);
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+void DataWatcher::stop() {
+    if (thread_.joinable()) {
+        const char byte = 0;
+        while (::write(stop_pipe_[1], &byte, 1) < 0 && errno == EINTR) {
+        }
+        thread_.join();
+    }
+    closeFd(inotify_fd_);
+    closeFd(stop_pipe_[0]);
+    closeFd(stop_pipe_[1]);
+}
+
+void DataWatcher::run() {
+    using Clock = std::chrono::steady_clock;
+    // (каталог, чат) -> когда файл успокоится
+    std::map<std::pair<size_t, int64_t>, Clock::time_point> pending;
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    while (true) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            auto next = std::min_element(pending.begin(), pending.end(),
+                [](const auto& a, const auto& b) { return a.second < b.second; })->second;
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - Clock::now()).count();
+            timeout = static_cast<int>(std::max<decltype(wait)>(wait, 0));
+        }
+
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+        if (::poll(fds, 2, timeout) < 0 && errno != EINTR) {
+            std::cerr << "Error: Data watcher stopped: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (fds[1].revents != 0) {
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t length;
+            while ((length = ::read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+                for (char* ptr = buffer; ptr < buffer + length;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        std::cerr << "Warning: Data watcher queue overflow, some edits were missed" << std::endl;
+                        continue;
+                    }
+                    auto dir = std::find(watches_.begin(), watches_.end(), event->wd);
+                    auto chat_id = event->len > 0 ? shardChatId(event->name) : std::nullopt;
+                    if (dir == watches_.end() || !chat_id) {
+                        continue;
+                    }
+                    pending[{static_cast<size_t>(dir - watches_.begin()), *chat_id}] = Clock::now() + kSettleDelay;
+                }
+            }
+        }
+
+        const auto now = Clock::now();
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->second > now) {
+                ++it;
+                continue;
+            }
+            const auto [dir, chat_id] = it->first;
+            it = pending.erase(it);
+            try {
+                onChange_(dirs_[dir], chat_id);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Reloading " << dirs_[dir] << "/" << chat_id << ".json failed: "
+                          << e.what() << std::endl;
+            }
+        }
+    }
+}
+
+#else
+
+void DataWatcher::start() {
+    std::cerr << "Warning: Data files are not watched on this platform; edits apply after restart" << std::endl;
+}
+
+void DataWatcher::stop() {}
+
+void DataWatcher::run() {}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Наблюдатель за JSON-файлами шардов (<каталог>/<chatId>.json), которые
+// правят снаружи бота - например, через смонтированный том с данными.
+//
+// Следит за каталогами через inotify (закрытие после записи и переименование
+// в каталог - так сохраняют редакторы и cp). Снапшоты и журналы в тех же
+// каталогах пишет сам бот, они отфильтровываются по расширению. События
+// одного файла копятся, пока он не простоит kSettleDelay без изменений:
+// редактор, записавший файл в несколько приемов, дает одну перезагрузку.
+// Колбэк вызывается в потоке наблюдателя, не в потоке обработчиков.
+//
+// inotify есть только в Linux; на других системах start() ничего не делает.
+class DataWatcher {
+public:
+    using Callback = std::function<void(const std::string& dir, int64_t chatId)>;
+
+    static constexpr std::chrono::milliseconds kSettleDelay{500};
+
+    DataWatcher(std::vector<std::string> dirs, Callback onChange);
+    ~DataWatcher();
+
+    DataWatcher(const DataWatcher&) = delete;
+    DataWatcher& operator=(const DataWatcher&) = delete;
+
+    void start();
+    void stop();
+
+private:
+    std::vector<std::string> dirs_;
+    Callback onChange_;
+    int inotify_fd_ = -1;
+    int stop_pipe_[2] = {-1, -1};
+    std::vector<int> watches_; // дескриптор наблюдения каждого каталога
+    std::thread thread_;
+
+    void run();
+};
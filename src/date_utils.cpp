@@ -0,0 +1,138 @@
+#include "date_utils.h"
+#include <atomic>
+#include <ctime>
+
+namespace {
+
+// Самопроверки календаря: считаются компилятором, ошибка - ошибка сборки.
+// Диапазоны разбиты на куски, чтобы каждый static_assert укладывался в лимит
+// шагов constexpr-вычислений
+
+// Каждый день лет [from, to) идет подряд и переводится туда и обратно без потерь
+constexpr bool checkDayNumbers(int from, int to) {
+    int expected = daysFromCivil(from, 1, 1);
+    for (int year = from; year < to; ++year) {
+        for (int month = 1; month <= 12; ++month) {
+            for (int day = 1; day <= daysInMonth(month, year); ++day) {
+                const CivilDate date{year, month, day};
+                if (daysFromCivil(date) != expected || civilFromDays(expected) != date) {
+                    return false;
+                }
+                ++expected;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(daysFromCivil(1970, 1, 1) == 0);
+static_assert(daysFromCivil(2000, 3, 1) == 11017);
+static_assert(civilFromDays(-1) == CivilDate{1969, 12, 31});
+static_assert(checkDayNumbers(1900, 1925));
+static_assert(checkDayNumbers(1925, 1950));
+static_assert(checkDayNumbers(1950, 1975));
+static_assert(checkDayNumbers(1975, 2000));
+static_assert(checkDayNumbers(2000, 2025));
+static_assert(checkDayNumbers(2025, 2050));
+static_assert(checkDayNumbers(2050, 2075));
+static_assert(checkDayNumbers(2075, 2100));
+static_assert(checkDayNumbers(2100, 2101)); // 2100 - не високосный
+
+// Дни до дня рождения день за днем убывают на 1 и после нуля начинаются
+// заново, а в нулевой день дата совпадает с днем рождения (29.02 - 1 марта)
+constexpr bool checkCountdown(int day, int month, int from, int to) {
+    int previous = -1;
+    for (int number = daysFromCivil(from, 1, 1); number < daysFromCivil(to, 1, 1); ++number) {
+        const CivilDate today = civilFromDays(number);
+        const int days = daysUntilBirthday(today, day, month);
+        if (days < 0 || days > 365 || (previous > 0 && days != previous - 1)) {
+            return false;
+        }
+        if (days == 0) {
+            const bool moved = month == 2 && day == 29 && !isLeapYear(today.year);
+            if (moved ? today != CivilDate{today.year, 3, 1} : today != CivilDate{today.year, month, day}) {
+                return false;
+            }
+        }
+        previous = days;
+    }
+    return true;
+}
+
+static_assert(checkCountdown(29, 2, 2019, 2029));
+static_assert(checkCountdown(28, 2, 2019, 2029));
+static_assert(checkCountdown(1, 3, 2019, 2029));
+static_assert(checkCountdown(1, 1, 2019, 2029));
+static_assert(checkCountdown(31, 12, 2019, 2029));
+static_assert(checkCountdown(31, 1, 2019, 2029));
+
+// С одной даты каждый день года находится через daysUntilBirthday дней
+constexpr bool checkEveryBirthday(const CivilDate& today) {
+    for (int month = 1; month <= 12; ++month) {
+        for (int day = 1; day <= daysInMonth(month, 2000); ++day) {
+            const CivilDate next = addDays(today, daysUntilBirthday(today, day, month));
+            const bool moved = month == 2 && day == 29 && !isLeapYear(next.year);
+            if (moved ? next != CivilDate{next.year, 3, 1} : (next.month != month || next.day != day)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(checkEveryBirthday({2023, 1, 1}));
+static_assert(checkEveryBirthday({2023, 12, 31}));
+static_assert(checkEveryBirthday({2024, 2, 29}));
+static_assert(checkEveryBirthday({2024, 3, 1}));
+
+// "Сегодня" и "завтра" на стыках месяцев и лет
+static_assert(daysUntilBirthday({2024, 12, 31}, 1, 1) == 1);
+static_assert(daysUntilBirthday({2025, 1, 31}, 1, 2) == 1);
+static_assert(daysUntilBirthday({2023, 2, 28}, 29, 2) == 1);
+static_assert(daysUntilBirthday({2024, 2, 28}, 29, 2) == 1);
+static_assert(daysUntilBirthday({2024, 3, 1}, 29, 2) == 365); // 29.02.2025 нет - 1 марта
+static_assert(daysUntilBirthday({2025, 6, 15}, 15, 6) == 0);
+
+static_assert(ageOn({2025, 2, 28}, {2000, 2, 29}) == 24);
+static_assert(ageOn({2025, 3, 1}, {2000, 2, 29}) == 25);
+static_assert(ageOn({2024, 2, 29}, {2000, 2, 29}) == 24);
+static_assert(ageOn({2024, 6, 14}, {1990, 6, 15}) == 33);
+static_assert(ageOn({2024, 6, 15}, {1990, 6, 15}) == 34);
+
+// Полночь UTC и смещения по обе стороны от нее
+static_assert(civilDateAt(0, 0) == CivilDate{1970, 1, 1});
+static_assert(civilDateAt(-1, 0) == CivilDate{1969, 12, 31});
+static_assert(civilDateAt(1735678800, 0) == CivilDate{2024, 12, 31});  // 2024-12-31 21:00 UTC
+static_assert(civilDateAt(1735678800, 180) == CivilDate{2025, 1, 1}); // Москва
+static_assert(civilDateAt(1735678800, -300) == CivilDate{2024, 12, 31});
+
+// Как часто перечитывать смещение сервера: переход на летнее время
+// подхватывается с такой задержкой
+constexpr int64_t kLocalOffsetRefreshSeconds = 5 * 60;
+
+std::atomic<int> local_offset_minutes{0};
+std::atomic<int64_t> local_offset_valid_until{0};
+
+int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+CivilDate todayAt(std::chrono::minutes offset) {
+    return civilDateAt(unixNow(), static_cast<int>(offset.count()));
+}
+
+std::chrono::minutes localUtcOffset() {
+    const int64_t now = unixNow();
+    if (now >= local_offset_valid_until.load(std::memory_order_acquire)) {
+        // Одновременный пересчет из нескольких потоков безвреден: результат один
+        const std::time_t time = static_cast<std::time_t>(now);
+        std::tm tm{};
+        localtime_r(&time, &tm);
+        local_offset_minutes.store(static_cast<int>(tm.tm_gmtoff / 60), std::memory_order_relaxed);
+        local_offset_valid_until.store(now + kLocalOffsetRefreshSeconds, std::memory_order_release);
+    }
+    return std::chrono::minutes(local_offset_minutes.load(std::memory_order_relaxed));
+}
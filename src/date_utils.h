@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Календарные функции, общие для менеджера дней рождения, ответов и рассылки.
+//
+// Вся арифметика - целочисленная над номером дня от 1970-01-01, без
+// localtime/mktime: функции constexpr, потокобезопасны и не зависят от TZ и
+// перехода на летнее время. Часовой пояс - просто смещение от UTC в минутах
+// (свое у каждого чата, см. ChatSettings). Самопроверки - static_assert в date_utils.cpp
+
+constexpr bool isLeapYear(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+constexpr int daysInMonth(int month, int year) {
+    constexpr int kDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month == 2 && isLeapYear(year)) {
+        return 29;
+    }
+    return kDays[month - 1];
+}
+
+constexpr bool isValidDate(int day, int month, int year) {
+    return month >= 1 && month <= 12 && day >= 1 && day <= daysInMonth(month, year) && year >= 1;
+}
+
+// Календарная дата без часового пояса
+struct CivilDate {
+    int year;
+    int month;
+    int day;
+
+    constexpr bool operator==(const CivilDate& other) const {
+        return year == other.year && month == other.month && day == other.day;
+    }
+    constexpr bool operator!=(const CivilDate& other) const { return !(*this == other); }
+};
+
+// Номер дня от 1970-01-01 по пролептическому григорианскому календарю
+// (алгоритм days_from_civil Говарда Хиннанта): разность двух дат - число дней между ними
+constexpr int daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yoe = year - era * 400;
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+constexpr int daysFromCivil(const CivilDate& date) {
+    return daysFromCivil(date.year, date.month, date.day);
+}
+
+// Обратное к daysFromCivil (civil_from_days того же автора)
+constexpr CivilDate civilFromDays(int days) {
+    days += 719468;
+    const int era = (days >= 0 ? days : days - 146096) / 146097;
+    const int doe = days - era * 146097;
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int mp = (5 * doy + 2) / 153;
+    const int day = doy - (153 * mp + 2) / 5 + 1;
+    const int month = mp < 10 ? mp + 3 : mp - 9;
+    return CivilDate{yoe + era * 400 + (month <= 2), month, day};
+}
+
+constexpr CivilDate addDays(const CivilDate& date, int days) {
+    return civilFromDays(daysFromCivil(date) + days);
+}
+
+// Дата в виде ГГГГММДД: отметки сравниваются как числа
+constexpr int32_t dateKey(const CivilDate& date) {
+    return date.year * 10000 + date.month * 100 + date.day;
+}
+
+// Номер дня, на который приходится день рождения day.month в году year:
+// 29.02 в невисокосный год - 1 марта, несуществующие даты из старых данных
+// прижимаются к концу месяца (как в календаре)
+constexpr int birthdayInYear(int day, int month, int year) {
+    if (month == 2 && day == 29 && !isLeapYear(year)) {
+        return daysFromCivil(year, 3, 1);
+    }
+    month = month < 1 ? 1 : month > 12 ? 12 : month;
+    const int last = daysInMonth(month, year);
+    return daysFromCivil(year, month, day < 1 ? 1 : day > last ? last : day);
+}
+
+// Дней от today до ближайшего дня рождения day.month (0 - сегодня)
+constexpr int daysUntilBirthday(const CivilDate& today, int day, int month) {
+    const int from = daysFromCivil(today);
+    int next = birthdayInYear(day, month, today.year);
+    if (next < from) {
+        next = birthdayInYear(day, month, today.year + 1);
+    }
+    return next - from;
+}
+
+// Полных лет на дату date у родившегося birth. День рождения 29.02 в
+// невисокосный год наступает 1 марта
+constexpr int ageOn(const CivilDate& date, const CivilDate& birth) {
+    const int age = date.year - birth.year;
+    return daysFromCivil(date) < birthdayInYear(birth.day, birth.month, date.year) ? age - 1 : age;
+}
+
+// Смещения часовых поясов, которые бывают на самом деле: от UTC-12 до UTC+14
+constexpr int kMinUtcOffsetMinutes = -12 * 60;
+constexpr int kMaxUtcOffsetMinutes = 14 * 60;
+
+// Календарная дата момента unix_seconds в поясе со смещением offset_minutes
+constexpr CivilDate civilDateAt(int64_t unix_seconds, int offset_minutes) {
+    const int64_t local = unix_seconds + int64_t{offset_minutes} * 60;
+    // Деление с округлением вниз: моменты до 1970 года тоже попадают в свой день
+    const int64_t days = local >= 0 ? local / 86400 : (local - 86399) / 86400;
+    return civilFromDays(static_cast<int>(days));
+}
+
+// Сегодняшняя дата в поясе со смещением offset
+CivilDate todayAt(std::chrono::minutes offset);
+
+// Смещение локального времени сервера (TZ) от UTC: пояс по умолчанию для
+// чатов без /tz. Берется из localtime_r не чаще раза в несколько минут, поэтому
+// переход на летнее время подхватывается, а горячий путь не трогает TZ-блокировку libc
+std::chrono::minutes localUtcOffset();
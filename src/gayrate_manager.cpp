@@ -1,78 +1,131 @@
 #include "gayrate_manager.h"
-#include <fstream>
-#include <iostream>
-#include <algorithm>
-#include <sstream>
-#include <iomanip>
 
 GayRateManager::GayRateManager(const std::string& file_path)
-    : data_file_path_(file_path) {
+    : records_(file_path) {
     loadData();
 }
 
 void GayRateManager::loadData() {
-    std::ifstream file(data_file_path_);
-    if (file.is_open()) {
-        try {
-            file >> data_;
-        } catch (const std::exception& e) {
-            std::cerr << "Error loading data: " << e.what() << std::endl;
-            data_ = nlohmann::json::object();
-        }
-        file.close();
-    } else {
-        // Создаем пустой JSON объект, если файл не существует
-        data_ = nlohmann::json::object();
+    // Снапшот (mmap) + журнал; отсутствующие файлы дают пустой рейтинг
+    records_.load();
+    const auto& grazd = records_.column(GayRateSchema::Grazd);
+    const auto& gayness = records_.column(GayRateSchema::Gayness);
+    for (uint32_t row = 0; row < records_.size(); ++row) {
+        grazd_rank_.insert(row, grazd[row]);
+        gayness_rank_.insert(row, gayness[row]);
     }
 }
 
-void GayRateManager::saveData() {
-    std::ofstream file(data_file_path_);
-    if (file.is_open()) {
-        file << data_.dump(4); // Красивое форматирование с отступами
-        file.close();
-    } else {
-        std::cerr << "Error: Cannot save data to file " << data_file_path_ << std::endl;
+GayRateInfo GayRateManager::infoAt(uint32_t row) const {
+    return GayRateInfo(std::string(records_.nickname(row)),
+                       records_.get(row, GayRateSchema::Grazd),
+                       records_.get(row, GayRateSchema::Gayness));
+}
+
+void GayRateManager::storeGayRate(const std::string& nickname, int grazd, int gayness) {
+    if (auto row = records_.find(nickname)) {
+        grazd_rank_.erase(*row, records_.get(*row, GayRateSchema::Grazd));
+        gayness_rank_.erase(*row, records_.get(*row, GayRateSchema::Gayness));
+    }
+    const uint32_t row = records_.put(nickname, {grazd, gayness});
+    grazd_rank_.insert(row, grazd);
+    gayness_rank_.insert(row, gayness);
+}
+
+void GayRateManager::removeGayRate(const std::string& nickname) {
+    auto row = records_.find(nickname);
+    if (!row) {
+        return;
+    }
+    // Порядок в рейтинге зависит от никнейма строки, поэтому ключи убираются
+    // до того, как хранилище переставит строки
+    grazd_rank_.erase(*row, records_.get(*row, GayRateSchema::Grazd));
+    gayness_rank_.erase(*row, records_.get(*row, GayRateSchema::Gayness));
+    const uint32_t last = static_cast<uint32_t>(records_.size() - 1);
+    if (last != *row) {
+        grazd_rank_.erase(last, records_.get(last, GayRateSchema::Grazd));
+        gayness_rank_.erase(last, records_.get(last, GayRateSchema::Gayness));
     }
+    // Последняя строка переезжает на место удаленной
+    if (records_.erase(nickname)) {
+        grazd_rank_.insert(*row, records_.get(*row, GayRateSchema::Grazd));
+        gayness_rank_.insert(*row, records_.get(*row, GayRateSchema::Gayness));
+    }
+}
+
+ReloadStats GayRateManager::replaceAll(std::vector<Record> records) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto diff = records_.diff(std::move(records));
+    for (const auto& nickname : diff.removed) {
+        removeGayRate(nickname);
+    }
+    for (const auto& [nickname, values] : diff.upserts) {
+        storeGayRate(nickname, values[GayRateSchema::Grazd], values[GayRateSchema::Gayness]);
+    }
+    // Индексы рейтинга ссылаются на номера строк, а не на никнеймы в арене
+    records_.compactNames();
+    return diff.stats();
 }
 
 void GayRateManager::addGayRate(const std::string& nickname, int grazd, int gayness) {
-    nlohmann::json gay_data;
-    gay_data["grazd"] = grazd;
-    gay_data["gayness"] = gayness;
+    std::lock_guard<std::mutex> lock(mutex_);
+    storeGayRate(nickname, grazd, gayness);
+}
 
-    data_[nickname] = gay_data;
-    saveData();
+void GayRateManager::setGrazd(const std::string& nickname, int grazd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto row = records_.find(nickname);
+    storeGayRate(nickname, grazd, row ? records_.get(*row, GayRateSchema::Gayness) : 0);
 }
 
-std::vector<GayRateInfo> GayRateManager::getTopGayRates(bool sort_by_grazd) {
+void GayRateManager::setGayness(const std::string& nickname, int gayness) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto row = records_.find(nickname);
+    storeGayRate(nickname, row ? records_.get(*row, GayRateSchema::Grazd) : 0, gayness);
+}
+
+std::vector<GayRateInfo> GayRateManager::getTopGayRates(bool sort_by_grazd, size_t limit) {
+    return getGayRatesSlice(sort_by_grazd, 0, limit);
+}
+
+std::vector<GayRateInfo> GayRateManager::getGayRatesSlice(bool sort_by_grazd, size_t offset, size_t count) {
     std::vector<GayRateInfo> rating;
 
-    for (auto& [nickname, gay_data] : data_.items()) {
-        int grazd = gay_data["grazd"];
-        int gayness = gay_data["gayness"];
-        rating.emplace_back(nickname, grazd, gayness);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [row, score] : ranking(sort_by_grazd).slice(offset, count)) {
+        rating.push_back(infoAt(row));
     }
+    return rating;
+}
 
-    std::sort(rating.begin(), rating.end(),
-        [&sort_by_grazd](const auto& a, const auto& b) {
-            if (sort_by_grazd) {
-                return a.grazd > b.grazd;
-            }
-            return a.gayness > b.gayness;
-        });
+std::optional<size_t> GayRateManager::getGayRank(const std::string& nickname, bool by_grazd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto row = records_.find(nickname);
+    if (!row) {
+        return std::nullopt;
+    }
+    const auto field = by_grazd ? GayRateSchema::Grazd : GayRateSchema::Gayness;
+    return ranking(by_grazd).rank(*row, records_.get(*row, field));
+}
 
-    return rating;
+size_t GayRateManager::getGayCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_.size();
 }
 
 bool GayRateManager::gayExists(const std::string& nickname) {
-    return data_.contains(nickname);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_.find(nickname).has_value();
 }
 
 GayRateInfo GayRateManager::getGayInfo(const std::string& nickname) {
-    if (data_.contains(nickname)) {
-        auto gay_data = data_[nickname];
-        return GayRateInfo(nickname, gay_data["grazd"], gay_data["gayness"]);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto row = records_.find(nickname)) {
+        return infoAt(*row);
     }
     return GayRateInfo("", 0, 0);
 }
+
+void GayRateManager::flush() {
+    records_.flush();
+}
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <chrono>
-#include <nlohmann/json.hpp>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include "record_store.h"
+#include "ranking_index.h"
 
 struct GayRateInfo {
     std::string nickname;
@@ -16,23 +22,59 @@ struct GayRateInfo {
         : nickname(nick), grazd(d), gayness(m) {}
 };
 
+struct GayRateSchema {
+    static constexpr std::array<const char*, 2> kFields{"grazd", "gayness"};
+    enum Field { Grazd, Gayness };
+};
+
 class GayRateManager {
 private:
-    std::string data_file_path_;
-    nlohmann::json data_;
+    // Обработчики команд выполняются в пуле потоков
+    mutable std::mutex mutex_;
+    RecordStore<GayRateSchema> records_;
+    // Рейтинги по каждой оценке (строки records_)
+    RankingIndex grazd_rank_{records_};
+    RankingIndex gayness_rank_{records_};
 
     void loadData();
-    void saveData();
+    const RankingIndex& ranking(bool by_grazd) const { return by_grazd ? grazd_rank_ : gayness_rank_; }
+    void storeGayRate(const std::string& nickname, int grazd, int gayness);
+    void removeGayRate(const std::string& nickname);
+    GayRateInfo infoAt(uint32_t row) const;
 
 public:
+    using Record = RecordStore<GayRateSchema>::Record;
+
     GayRateManager(const std::string& file_path = "GayRates.json");
 
     void addGayRate(const std::string& nickname, int grazd, int gayness);
 
-    std::vector<GayRateInfo> getTopGayRates(bool sort_by_grazd);
+    // Обновить одно измерение, сохранив второе (атомарно относительно других потоков)
+    void setGrazd(const std::string& nickname, int grazd);
+    void setGayness(const std::string& nickname, int gayness);
+
+    // Привести данные к полному списку records (JSON-файл, исправленный
+    // снаружи): меняются только отличающиеся записи, рейтинги обновляются
+    // точечно, все изменения применяются под одной блокировкой
+    ReloadStats replaceAll(std::vector<Record> records);
+
+    // Первые limit мест рейтинга (по умолчанию весь рейтинг)
+    std::vector<GayRateInfo> getTopGayRates(bool sort_by_grazd,
+                                            size_t limit = std::numeric_limits<size_t>::max());
+
+    // Страница рейтинга: до count мест начиная с offset (с нуля)
+    std::vector<GayRateInfo> getGayRatesSlice(bool sort_by_grazd, size_t offset, size_t count);
+
+    // Место пользователя в рейтинге (с нуля) или nullopt, если его нет
+    std::optional<size_t> getGayRank(const std::string& nickname, bool by_grazd);
+
+    size_t getGayCount();
 
     bool gayExists(const std::string& nickname);
 
     // Получить информацию о пользователе
     GayRateInfo getGayInfo(const std::string& nickname);
+
+    // Дождаться, пока все изменения окажутся на диске
+    void flush();
 };
@@ -0,0 +1,103 @@
+#include "handler_pool.h"
+#include <iostream>
+
+HandlerPool::HandlerPool(size_t threads, size_t capacity)
+    : capacity_(capacity == 0 ? 1 : capacity) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back([this]() { run(); });
+    }
+}
+
+HandlerPool::~HandlerPool() {
+    stop();
+}
+
+void HandlerPool::submit(int64_t key, Task task) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [this] { return stopping_ || queued_ < capacity_; });
+        if (stopping_) {
+            return;
+        }
+
+        auto& strand = strands_[key];
+        strand.tasks.push_back(std::move(task));
+        ++queued_;
+        if (strand.active) {
+            // Чат уже обрабатывается: задача выполнится следом за предыдущими
+            return;
+        }
+        strand.active = true;
+        runnable_.push_back(key);
+    }
+    work_cv_.notify_one();
+}
+
+void HandlerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    space_cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+size_t HandlerPool::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_;
+}
+
+void HandlerPool::run() {
+    while (true) {
+        int64_t key;
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [this] { return stopping_ || !runnable_.empty(); });
+            if (runnable_.empty()) {
+                return; // stopping_ и больше нечего выполнять
+            }
+            key = runnable_.front();
+            runnable_.pop_front();
+            auto& strand = strands_[key];
+            task = std::move(strand.tasks.front());
+            strand.tasks.pop_front();
+            --queued_;
+        }
+        space_cv_.notify_one();
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Unhandled exception in handler: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Unhandled exception in handler" << std::endl;
+        }
+
+        bool more = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = strands_.find(key);
+            if (it->second.tasks.empty()) {
+                strands_.erase(it);
+            } else {
+                // Следующая задача чата встает в конец, чтобы соседние чаты не голодали
+                runnable_.push_back(key);
+                more = true;
+            }
+        }
+        if (more) {
+            work_cv_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Пул обработчиков входящих обновлений.
+//
+// Задачи с одним ключом (id чата) выполняются строго по очереди, задачи разных
+// чатов - параллельно на нескольких потоках. Очередь ограничена: когда пул
+// захлебывается, submit ждет свободного места (backpressure на поток приема).
+class HandlerPool {
+public:
+    using Task = std::function<void()>;
+
+    HandlerPool(size_t threads, size_t capacity);
+    ~HandlerPool();
+
+    HandlerPool(const HandlerPool&) = delete;
+    HandlerPool& operator=(const HandlerPool&) = delete;
+
+    void submit(int64_t key, Task task);
+
+    // Выполнить уже принятые задачи и остановить потоки
+    void stop();
+
+    // Количество задач в очереди (без выполняющихся)
+    size_t size();
+
+private:
+    // Очередь задач одного чата; active - чат стоит в runnable_ или выполняется
+    struct Strand {
+        std::deque<Task> tasks;
+        bool active = false;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable space_cv_;
+    std::unordered_map<int64_t, Strand> strands_;
+    std::deque<int64_t> runnable_;
+    size_t queued_ = 0;
+    size_t capacity_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    void run();
+};
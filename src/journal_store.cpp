@@ -0,0 +1,741 @@
+#include "journal_store.h"
+#include "metrics.h"
+#include "snapshot_format.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Сколько ждем попутные записи перед сбросом пачки на диск
+constexpr auto kGroupCommitWindow = std::chrono::milliseconds(5);
+// Как часто компактор проверяет размеры журналов
+constexpr auto kCompactionCheckInterval = std::chrono::seconds(10);
+// Сколько раз read() перечитывает хранилище, если компакция сменила файлы
+constexpr int kReadAttempts = 5;
+// Журнал меньше этого размера не компактируем
+constexpr size_t kMinCompactionBytes = 256 * 1024;
+// Пауза перед повтором пачки, которую не удалось записать (диск полон и т.п.)
+constexpr auto kCommitRetryDelay = std::chrono::seconds(1);
+
+struct StorageMetrics {
+    Histogram& commit_seconds;
+    Counter& commit_bytes;
+    Histogram& commit_batch_bytes;
+    Histogram& compaction_seconds;
+    Gauge& snapshot_bytes;
+};
+
+StorageMetrics& storageMetrics() {
+    auto& registry = MetricsRegistry::instance();
+    static StorageMetrics metrics{
+        registry.histogram("bot_storage_commit_seconds", "Journal group commit duration (write + fdatasync)", latencyBuckets()),
+        registry.counter("bot_storage_written_bytes_total", "Bytes appended to journals"),
+        registry.histogram("bot_storage_commit_batch_bytes", "Bytes written per group commit", bytesBuckets()),
+        registry.histogram("bot_storage_compaction_seconds", "Snapshot compaction duration", latencyBuckets()),
+        registry.gauge("bot_storage_snapshot_bytes", "Size of the last written snapshot"),
+    };
+    return metrics;
+}
+
+bool syncFile(int fd) {
+#ifdef __APPLE__
+    return ::fsync(fd) == 0;
+#else
+    return ::fdatasync(fd) == 0;
+#endif
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool fileExists(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+// Синхронизировать каталог, чтобы rename пережил падение
+void syncParentDir(const std::string& path) {
+    auto slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    if (dir.empty()) dir = "/";
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+bool fileMtime(const std::string& path, struct timespec& mtime) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+#ifdef __APPLE__
+    mtime = st.st_mtimespec;
+#else
+    mtime = st.st_mtim;
+#endif
+    return true;
+}
+
+bool newer(const struct timespec& a, const struct timespec& b) {
+    return a.tv_sec != b.tv_sec ? a.tv_sec > b.tv_sec : a.tv_nsec > b.tv_nsec;
+}
+
+// Изменения поверх снапшота: nullopt - ключ удален
+using Overlay = std::map<std::string, std::optional<JournalStore::Values>>;
+
+JournalStore::Values valuesFromJson(const nlohmann::json& value, const std::vector<std::string>& fields) {
+    JournalStore::Values values(fields.size(), 0);
+    if (!value.is_object()) {
+        return values;
+    }
+    for (size_t f = 0; f < fields.size(); ++f) {
+        auto it = value.find(fields[f]);
+        if (it != value.end() && it->is_number_integer()) {
+            values[f] = it->get<int32_t>();
+        }
+    }
+    return values;
+}
+
+void applyRecord(Overlay& overlay, const nlohmann::json& record, const std::vector<std::string>& fields) {
+    const std::string& key = record.at("k").get_ref<const std::string&>();
+    if (record.contains("v")) {
+        overlay[key] = valuesFromJson(record["v"], fields);
+    } else {
+        overlay[key] = std::nullopt;
+    }
+}
+
+// Проиграть журнал поверх изменений. Возвращает длину до конца последней
+// целой строки: оборванный хвост (падение посреди записи) отбрасывается.
+// Поврежденная строка в середине пропускается - записи после нее сохраняются.
+size_t replayLines(std::istream& file, const std::string& path, Overlay& overlay,
+                   const std::vector<std::string>& fields) {
+    size_t valid = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (file.eof()) {
+            // Строка без '\n' - запись не дошла до диска целиком
+            break;
+        }
+        try {
+            applyRecord(overlay, nlohmann::json::parse(line), fields);
+        } catch (const std::exception& e) {
+            std::cerr << "Journal " << path << " has a damaged record at offset " << valid
+                      << ", skipped: " << e.what() << std::endl;
+        }
+        valid += line.size() + 1;
+    }
+    return valid;
+}
+
+size_t replayJournal(const std::string& path, Overlay& overlay, const std::vector<std::string>& fields) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    return replayLines(file, path, overlay, fields);
+}
+
+// Открыть файл только для чтения; -1 и errno == ENOENT - файла нет
+int openForRead(const std::string& path) {
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+bool readAll(int fd, std::string& out) {
+    char buffer[64 * 1024];
+    ssize_t length;
+    while ((length = ::read(fd, buffer, sizeof(buffer))) != 0) {
+        if (length < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        out.append(buffer, static_cast<size_t>(length));
+    }
+    return true;
+}
+
+// Тот же ли файл лежит по пути: fd < 0 - файла не было и нет до сих пор
+bool sameFile(int fd, const std::string& path) {
+    struct stat by_path;
+    if (::stat(path.c_str(), &by_path) != 0) {
+        return fd < 0 && errno == ENOENT;
+    }
+    struct stat by_fd;
+    return fd >= 0 && ::fstat(fd, &by_fd) == 0
+        && by_fd.st_dev == by_path.st_dev && by_fd.st_ino == by_path.st_ino;
+}
+
+// Открыть снапшот; поврежденный файл откладывается в сторону, чтобы компакция
+// не затерла его и данные можно было достать вручную
+void openSnapshot(MappedSnapshot& snapshot, const std::string& path) {
+    if (snapshot.open(path) == SnapshotStatus::Corrupt) {
+        std::cerr << "Error loading data: snapshot " << path << " is damaged ("
+                  << snapshot.error() << "), moved to " << path << ".corrupt" << std::endl;
+        ::rename(path.c_str(), (path + ".corrupt").c_str());
+    }
+}
+
+// Слить снапшот с изменениями в порядке ключей. Если поля снапшота совпадают
+// со схемой, значения передаются прямо из отображенного файла
+template <typename Emit>
+void mergeState(const MappedSnapshot& snapshot, const Overlay& overlay,
+                const std::vector<std::string>& fields, Emit&& emit) {
+    std::vector<int> remap(fields.size(), -1);
+    bool identity = snapshot.fields().size() == fields.size();
+    for (size_t f = 0; f < fields.size(); ++f) {
+        auto it = std::find(snapshot.fields().begin(), snapshot.fields().end(), fields[f]);
+        if (it != snapshot.fields().end()) {
+            remap[f] = static_cast<int>(it - snapshot.fields().begin());
+        }
+        identity = identity && remap[f] == static_cast<int>(f);
+    }
+    JournalStore::Values converted(fields.size());
+    auto emitSnapshot = [&](size_t i) {
+        if (identity) {
+            emit(snapshot.key(i), snapshot.values(i));
+            return;
+        }
+        for (size_t f = 0; f < fields.size(); ++f) {
+            converted[f] = remap[f] >= 0 ? snapshot.values(i)[remap[f]] : 0;
+        }
+        emit(snapshot.key(i), converted.data());
+    };
+    auto emitOverlay = [&](const Overlay::value_type& change) {
+        if (change.second) {
+            emit(change.first, change.second->data());
+        }
+    };
+
+    size_t i = 0;
+    auto change = overlay.begin();
+    while (i < snapshot.size() && change != overlay.end()) {
+        const std::string_view key = snapshot.key(i);
+        if (key < change->first) {
+            emitSnapshot(i++);
+        } else {
+            if (key == change->first) {
+                ++i; // запись снапшота заменена или удалена журналом
+            }
+            emitOverlay(*change++);
+        }
+    }
+    for (; i < snapshot.size(); ++i) {
+        emitSnapshot(i);
+    }
+    for (; change != overlay.end(); ++change) {
+        emitOverlay(*change);
+    }
+}
+
+// Атомарно переписать файл: temp-файл, fsync, rename
+bool writeFileAtomically(const std::string& path, const std::string& data) {
+    const std::string tmp_path = path + ".tmp";
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot save data to file " << tmp_path << std::endl;
+        return false;
+    }
+    const bool written = writeAll(fd, data.data(), data.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!written || ::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Cannot save data to file " << path
+                  << ": " << std::strerror(errno) << std::endl;
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    syncParentDir(path);
+    return true;
+}
+
+// Записать снапшот = старый снапшот + изменения
+bool writeSnapshot(const std::string& path, const MappedSnapshot& base, const Overlay& overlay,
+                   const std::vector<std::string>& fields, size_t& bytes) {
+    SnapshotEncoder encoder(fields);
+    mergeState(base, overlay, fields, [&encoder](std::string_view key, const int32_t* values) {
+        encoder.add(key, values);
+    });
+    const std::string data = encoder.finish();
+    if (!writeFileAtomically(path, data)) {
+        return false;
+    }
+    bytes = data.size();
+    return true;
+}
+
+} // namespace
+
+// Один фоновый поток group commit и один поток компактора на все хранилища
+class StorageWorker {
+public:
+    static StorageWorker& instance() {
+        static StorageWorker worker;
+        return worker;
+    }
+
+    void registerStore(JournalStore* store) {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        stores_.push_back(store);
+    }
+
+    void unregisterStore(JournalStore* store) {
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            stores_.erase(std::remove(stores_.begin(), stores_.end(), store), stores_.end());
+        }
+        // Дожидаемся текущих проходов, которые могли захватить store до удаления
+        std::lock_guard<std::mutex> commit_lock(commit_round_mutex_);
+        std::lock_guard<std::mutex> compact_lock(compact_round_mutex_);
+    }
+
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            work_pending_ = true;
+        }
+        wake_cv_.notify_one();
+    }
+
+private:
+    std::mutex registry_mutex_;
+    std::vector<JournalStore*> stores_;
+
+    std::mutex commit_round_mutex_;
+    std::mutex compact_round_mutex_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable stop_cv_;
+    bool work_pending_ = false;
+    bool stop_ = false;
+
+    std::thread committer_;
+    std::thread compactor_;
+
+    StorageWorker() {
+        committer_ = std::thread([this]() { runCommitter(); });
+        compactor_ = std::thread([this]() { runCompactor(); });
+    }
+
+    ~StorageWorker() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_ = true;
+        }
+        wake_cv_.notify_all();
+        stop_cv_.notify_all();
+        if (committer_.joinable()) committer_.join();
+        if (compactor_.joinable()) compactor_.join();
+    }
+
+    template <typename Fn>
+    void forEachStore(std::mutex& round_mutex, Fn&& fn) {
+        std::lock_guard<std::mutex> round(round_mutex);
+        std::vector<JournalStore*> stores;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            stores = stores_;
+        }
+        for (auto* store : stores) {
+            fn(store);
+        }
+    }
+
+    void runCommitter() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                wake_cv_.wait(lock, [this] { return stop_ || work_pending_; });
+                if (stop_ && !work_pending_) break;
+                work_pending_ = false;
+            }
+            // Даем попутным записям попасть в ту же пачку
+            std::this_thread::sleep_for(kGroupCommitWindow);
+            bool failed = false;
+            forEachStore(commit_round_mutex_, [&failed](JournalStore* store) {
+                failed = !store->commit() || failed;
+            });
+            if (failed) {
+                // Несохраненные пачки остались в очереди хранилищ - повторяем позже
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                if (stop_cv_.wait_for(lock, kCommitRetryDelay, [this] { return stop_; })) break;
+                work_pending_ = true;
+            }
+        }
+    }
+
+    void runCompactor() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                if (stop_cv_.wait_for(lock, kCompactionCheckInterval, [this] { return stop_; })) break;
+            }
+            forEachStore(compact_round_mutex_, [](JournalStore* store) {
+                if (store->needsCompaction()) {
+                    store->compact();
+                }
+            });
+        }
+    }
+};
+
+std::string storeBasePath(const std::string& json_path) {
+    const std::string suffix = ".json";
+    if (json_path.size() > suffix.size()
+        && json_path.compare(json_path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return json_path.substr(0, json_path.size() - suffix.size());
+    }
+    return json_path;
+}
+
+JournalStore::JournalStore(const std::string& json_path, std::vector<std::string> fields)
+    : fields_(std::move(fields)),
+      json_path_(json_path),
+      snapshot_path_(storeBasePath(json_path) + ".snap"),
+      journal_path_(storeBasePath(json_path) + ".journal"),
+      compacting_path_(storeBasePath(json_path) + ".journal.compacting") {
+    StorageWorker::instance().registerStore(this);
+}
+
+JournalStore::~JournalStore() {
+    StorageWorker::instance().unregisterStore(this);
+    if (!commit()) {
+        std::cerr << "Error: Unsaved changes to " << journal_path_ << " are lost" << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    if (journal_fd_ >= 0) {
+        ::close(journal_fd_);
+        journal_fd_ = -1;
+    }
+}
+
+bool jsonNewerThanStore(const std::string& json_path) {
+    struct timespec json_time, other_time;
+    if (!fileMtime(json_path, json_time)) {
+        return false;
+    }
+    const std::string base = storeBasePath(json_path);
+    for (const auto& path : {base + ".snap", base + ".journal", base + ".journal.compacting"}) {
+        if (fileMtime(path, other_time) && !newer(json_time, other_time)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JournalStore::read(const std::string& json_path, const std::vector<std::string>& fields,
+                        const RecordVisitor& visit, struct timespec* newest_mtime) {
+    const std::string base = storeBasePath(json_path);
+    const std::string snapshot_path = base + ".snap";
+    const std::string journal_path = base + ".journal";
+    const std::string compacting_path = base + ".journal.compacting";
+
+    for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+        // Журнал, затем журнал компакции, затем снапшот. Если после этого по
+        // пути журнала лежит тот же файл, ротации между открытиями не было:
+        // журнал компакции старше журнала, а снапшот либо еще не включает
+        // его, либо уже включает - проигрывание поверх дает одно и то же.
+        // Иначе снапшот мог вобрать записи, которых нет в открытых журналах
+        const int journal_fd = openForRead(journal_path);
+        const int compacting_fd = openForRead(compacting_path);
+        MappedSnapshot snapshot;
+        const SnapshotStatus status = snapshot.open(snapshot_path);
+        const bool stable = sameFile(journal_fd, journal_path);
+
+        struct timespec newest{};
+        auto takeNewer = [&newest](const struct stat& st) {
+#ifdef __APPLE__
+            const struct timespec& mtime = st.st_mtimespec;
+#else
+            const struct timespec& mtime = st.st_mtim;
+#endif
+            if (newer(mtime, newest)) {
+                newest = mtime;
+            }
+        };
+        struct stat st;
+        if (journal_fd >= 0 && ::fstat(journal_fd, &st) == 0) takeNewer(st);
+        if (compacting_fd >= 0 && ::fstat(compacting_fd, &st) == 0) takeNewer(st);
+        if (status == SnapshotStatus::Ok && ::stat(snapshot_path.c_str(), &st) == 0) takeNewer(st);
+
+        std::string journal, compacting;
+        const bool read_ok = (journal_fd < 0 || readAll(journal_fd, journal))
+            && (compacting_fd < 0 || readAll(compacting_fd, compacting));
+        if (journal_fd >= 0) ::close(journal_fd);
+        if (compacting_fd >= 0) ::close(compacting_fd);
+
+        if (status == SnapshotStatus::Corrupt) {
+            std::cerr << "Error: Snapshot " << snapshot_path << " is damaged: " << snapshot.error() << std::endl;
+            return false;
+        }
+        if (!read_ok) {
+            std::cerr << "Error: Cannot read journal " << journal_path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (!stable) {
+            continue;
+        }
+
+        Overlay overlay;
+        std::istringstream compacting_lines(compacting);
+        replayLines(compacting_lines, compacting_path, overlay, fields);
+        std::istringstream journal_lines(journal);
+        replayLines(journal_lines, journal_path, overlay, fields);
+        mergeState(snapshot, overlay, fields, visit);
+        if (newest_mtime) {
+            *newest_mtime = newest;
+        }
+        return true;
+    }
+    std::cerr << "Error: " << base << " keeps changing during compaction, try again" << std::endl;
+    return false;
+}
+
+void JournalStore::importJson() {
+    if (!jsonNewerThanStore(json_path_)) {
+        return; // JSON уже импортирован или выгружен раньше последних изменений
+    }
+
+    nlohmann::json data;
+    std::ifstream file(json_path_);
+    try {
+        file >> data;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading data: " << json_path_ << ": " << e.what() << std::endl;
+        return;
+    }
+    if (!data.is_object()) {
+        std::cerr << "Error loading data: " << json_path_ << " is not a JSON object" << std::endl;
+        return;
+    }
+
+    Overlay state;
+    for (auto& [key, value] : data.items()) {
+        state[key] = valuesFromJson(value, fields_);
+    }
+    // Журналы версий с JSON-снапшотом: <база>.json.journal(.compacting)
+    const std::string legacy_journal = json_path_ + ".journal";
+    replayJournal(legacy_journal + ".compacting", state, fields_);
+    replayJournal(legacy_journal, state, fields_);
+
+    MappedSnapshot empty;
+    size_t bytes = 0;
+    if (!writeSnapshot(snapshot_path_, empty, state, fields_, bytes)) {
+        return;
+    }
+    // JSON заменяет состояние целиком: старые изменения больше не нужны
+    ::unlink(compacting_path_.c_str());
+    ::truncate(journal_path_.c_str(), 0);
+    ::unlink((legacy_journal + ".compacting").c_str());
+    ::unlink(legacy_journal.c_str());
+    std::cerr << "Imported " << state.size() << " records from " << json_path_
+              << " into " << snapshot_path_ << std::endl;
+}
+
+void JournalStore::load(const RecordVisitor& visit) {
+    importJson();
+
+    MappedSnapshot snapshot;
+    openSnapshot(snapshot, snapshot_path_);
+
+    // Компакция была прервана: ее журнал еще не попал в снапшот
+    Overlay overlay;
+    const bool interrupted_compaction = fileExists(compacting_path_);
+    if (interrupted_compaction) {
+        replayJournal(compacting_path_, overlay, fields_);
+    }
+    const size_t valid = replayJournal(journal_path_, overlay, fields_);
+
+    {
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        snapshot_bytes_ = snapshot.bytes();
+        // Отрезаем оборванный хвост, чтобы новые записи не склеились с мусором
+        if (fileExists(journal_path_)) {
+            ::truncate(journal_path_.c_str(), static_cast<off_t>(valid));
+        }
+        journal_bytes_ = valid;
+        if (interrupted_compaction) {
+            // Доводим компакцию до конца синхронно, иначе следующая ротация перезапишет файл
+            size_t bytes = 0;
+            if (writeSnapshot(snapshot_path_, snapshot, overlay, fields_, bytes)) {
+                ::unlink(compacting_path_.c_str());
+                ::truncate(journal_path_.c_str(), 0);
+                journal_bytes_ = 0;
+                snapshot_bytes_ = bytes;
+                overlay.clear();
+                openSnapshot(snapshot, snapshot_path_);
+            }
+        }
+        openJournal();
+        loaded_ = true;
+    }
+
+    mergeState(snapshot, overlay, fields_, visit);
+}
+
+void JournalStore::put(const std::string& key, const nlohmann::json& value) {
+    nlohmann::json record;
+    record["k"] = key;
+    record["v"] = value;
+    append(record.dump());
+}
+
+void JournalStore::erase(const std::string& key) {
+    nlohmann::json record;
+    record["k"] = key;
+    append(record.dump());
+}
+
+void JournalStore::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t target = appended_;
+    if (committed_ >= target) {
+        return;
+    }
+    StorageWorker::instance().wake();
+    committed_cv_.wait(lock, [this, target] { return committed_ >= target; });
+}
+
+void JournalStore::append(std::string line) {
+    line.push_back('\n');
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.append(line);
+        ++appended_;
+    }
+    StorageWorker::instance().wake();
+}
+
+bool JournalStore::commit() {
+    std::string batch;
+    uint64_t batch_end;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty()) {
+            return true;
+        }
+        batch.swap(pending_);
+        batch_end = appended_;
+    }
+
+    bool written = false;
+    {
+        auto& metrics = storageMetrics();
+        ScopedTimer timer(metrics.commit_seconds);
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        if (journal_fd_ < 0) {
+            openJournal();
+        }
+        struct stat st;
+        if (journal_fd_ >= 0 && ::fstat(journal_fd_, &st) == 0) {
+            written = writeAll(journal_fd_, batch.data(), batch.size()) && syncFile(journal_fd_);
+            if (written) {
+                journal_bytes_ = static_cast<size_t>(st.st_size) + batch.size();
+                metrics.commit_bytes.inc(batch.size());
+                metrics.commit_batch_bytes.observe(static_cast<double>(batch.size()));
+            } else {
+                std::cerr << "Error: Cannot append to journal " << journal_path_
+                          << ": " << std::strerror(errno) << std::endl;
+                // Отрезаем недописанную часть пачки, иначе следующая склеится с ней
+                if (::ftruncate(journal_fd_, st.st_size) != 0) {
+                    std::cerr << "Error: Cannot truncate journal " << journal_path_
+                              << ": " << std::strerror(errno) << std::endl;
+                }
+            }
+        } else {
+            std::cerr << "Error: Cannot append to journal " << journal_path_
+                      << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (written) {
+            committed_ = batch_end;
+        } else {
+            // Пачка возвращается в начало очереди и уйдет в следующий проход;
+            // flush() ждет, пока она не окажется на диске
+            batch.append(pending_);
+            pending_.swap(batch);
+        }
+    }
+    if (written) {
+        committed_cv_.notify_all();
+    }
+    return written;
+}
+
+bool JournalStore::needsCompaction() {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    return loaded_
+        && (journal_bytes_ > std::max(kMinCompactionBytes, snapshot_bytes_) || fileExists(compacting_path_));
+}
+
+void JournalStore::compact() {
+    auto& metrics = storageMetrics();
+    ScopedTimer timer(metrics.compaction_seconds);
+    {
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        // Если прошлая компакция не дописала снапшот, сначала повторяем ее
+        if (!fileExists(compacting_path_)) {
+            if (journal_fd_ >= 0) {
+                ::close(journal_fd_);
+                journal_fd_ = -1;
+            }
+            if (::rename(journal_path_.c_str(), compacting_path_.c_str()) != 0) {
+                std::cerr << "Error: Cannot rotate journal " << journal_path_
+                          << ": " << std::strerror(errno) << std::endl;
+                return;
+            }
+            journal_bytes_ = 0;
+        }
+    }
+
+    // Новые записи уже идут в свежий журнал, снапшот собираем без блокировок:
+    // старый снапшот отображен в память и сливается с журналом за один проход
+    MappedSnapshot snapshot;
+    openSnapshot(snapshot, snapshot_path_);
+    Overlay overlay;
+    replayJournal(compacting_path_, overlay, fields_);
+    size_t bytes = 0;
+    if (writeSnapshot(snapshot_path_, snapshot, overlay, fields_, bytes)) {
+        ::unlink(compacting_path_.c_str());
+        metrics.snapshot_bytes.set(static_cast<int64_t>(bytes));
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        snapshot_bytes_ = bytes;
+    }
+}
+
+void JournalStore::openJournal() {
+    journal_fd_ = ::open(journal_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (journal_fd_ < 0) {
+        std::cerr << "Error: Cannot open journal " << journal_path_
+                  << ": " << std::strerror(errno) << std::endl;
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+class StorageWorker;
+
+// Журналируемое хранилище "ключ -> набор целочисленных полей".
+//
+// Изменения дописываются строками JSON в <база>.journal, фоновый поток
+// сбрасывает их пачками (group commit), поэтому стоимость записи зависит от
+// размера изменения, а не от размера всех данных. Компактор время от времени
+// сливает журнал с бинарным снапшотом <база>.snap (snapshot_format.h) и
+// атомарно переписывает его (temp + rename), так что оборванная запись не
+// портит данные. При старте снапшот читается через mmap, поверх проигрывается
+// незавершенная компакция и журнал.
+//
+// <база>.json - формат импорта и экспорта: если он новее снапшота и журнала
+// (правка руками, файл старой версии), при загрузке он заменяет состояние.
+class JournalStore {
+public:
+    using Values = std::vector<int32_t>;
+    // Запись состояния: ключ и значения полей в порядке схемы. Указатели
+    // действительны только во время вызова
+    using RecordVisitor = std::function<void(std::string_view key, const int32_t* values)>;
+
+    // json_path - <база>.json; fields - имена полей значения в порядке схемы
+    JournalStore(const std::string& json_path, std::vector<std::string> fields);
+    ~JournalStore();
+
+    JournalStore(const JournalStore&) = delete;
+    JournalStore& operator=(const JournalStore&) = delete;
+
+    const std::vector<std::string>& fields() const { return fields_; }
+
+    // Загрузить состояние с диска. Записи приходят по возрастанию ключа.
+    // Вызывается до первых изменений
+    void load(const RecordVisitor& visit);
+
+    // Прочитать состояние хранилища <база>.json, ничего не записывая на диск
+    // (load() дописывает прерванную компакцию и обрезает журнал). Безопасно,
+    // пока хранилище открыто в другом процессе: компакция, прошедшая во
+    // время чтения, дает повторную попытку. Журнал берется до последней
+    // целой строки. newest_mtime - самое позднее время изменения прочитанных
+    // файлов. false - снапшот поврежден или файлы не читаются
+    static bool read(const std::string& json_path, const std::vector<std::string>& fields,
+                     const RecordVisitor& visit, struct timespec* newest_mtime = nullptr);
+
+    // Записать значение ключа (JSON-объект с полями схемы). Не ждет диска:
+    // запись уйдет в ближайший group commit
+    void put(const std::string& key, const nlohmann::json& value);
+
+    // Удалить ключ
+    void erase(const std::string& key);
+
+    // Дождаться, пока все добавленные изменения окажутся на диске. Если запись
+    // не удается, пачка повторяется раз в секунду, и flush() ждет успеха
+    void flush();
+
+private:
+    friend class StorageWorker;
+
+    std::vector<std::string> fields_;
+    std::string json_path_;
+    std::string snapshot_path_;
+    std::string journal_path_;
+    std::string compacting_path_;
+
+    // Очередь строк журнала, ожидающих group commit
+    std::mutex mutex_;
+    std::condition_variable committed_cv_;
+    std::string pending_;
+    uint64_t appended_ = 0;
+    uint64_t committed_ = 0;
+
+    // Дескриптор журнала, ротация и размеры файлов
+    std::mutex io_mutex_;
+    int journal_fd_ = -1;
+    size_t journal_bytes_ = 0;
+    size_t snapshot_bytes_ = 0;
+    bool loaded_ = false; // до загрузки компактор хранилище не трогает
+
+    void importJson();
+    void append(std::string line);
+    bool commit(); // false - пачка не записана и осталась в очереди
+    bool needsCompaction();
+    void compact();
+    void openJournal();
+};
+
+// <база> для пути к JSON-файлу хранилища: "birthdays/1.json" -> "birthdays/1"
+std::string storeBasePath(const std::string& json_path);
+
+// Новее ли <база>.json снапшота и журналов хранилища. Файл не новее их
+// выгружен или импортирован раньше последних изменений и их не содержит
+bool jsonNewerThanStore(const std::string& json_path);
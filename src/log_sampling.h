@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+
+// Ограничитель частоты записей одного места в коде: не больше limit записей
+// за window. Счетчики - атомики без блокировок, так что проверка стоит
+// пару атомарных операций и на горячем пути.
+class LogSampler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LogSampler(uint32_t limit, Clock::duration window = std::chrono::seconds(1))
+        : limit_(limit), window_(window.count()) {}
+
+    // true - запись делать. suppressed - сколько записей пропущено перед ней
+    bool sample(uint64_t& suppressed) {
+        const int64_t now = Clock::now().time_since_epoch().count();
+        int64_t start = window_start_.load(std::memory_order_relaxed);
+        if (now - start >= window_
+            && window_start_.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            // Окно открывает один поток; гонка на границе окна дает лишнюю запись, не потерю
+            count_.store(0, std::memory_order_relaxed);
+        }
+        if (count_.fetch_add(1, std::memory_order_relaxed) < limit_) {
+            suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+private:
+    const uint32_t limit_;
+    const int64_t window_;
+    std::atomic<int64_t> window_start_{0};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+// Запись с ограничением частоты на место вызова: не больше limit в секунду.
+// Число пропущенных записей сообщается перед следующей записанной. При
+// выключенном уровне не считаются ни выборка, ни аргументы
+#define LOG_SAMPLED(logger, level, limit, ...)                                                        \
+    do {                                                                                              \
+        static LogSampler log_sampler_{limit};                                                        \
+        uint64_t log_suppressed_ = 0;                                                                 \
+        if ((logger)->should_log(level) && log_sampler_.sample(log_suppressed_)) {                    \
+            if (log_suppressed_ > 0) {                                                                \
+                (logger)->log(level, "{} similar records suppressed", log_suppressed_);              \
+            }                                                                                         \
+            (logger)->log(level, __VA_ARGS__);                                                        \
+        }                                                                                             \
+    } while (false)
+
+// Начало текста для записи в лог. Обрезка происходит только при
+// форматировании, то есть когда уровень записи включен: на отброшенной записи
+// не строится ни подстрока, ни "...". Обрезается по границе символа UTF-8
+struct Truncated {
+    std::string_view text;
+    size_t limit;
+};
+
+inline Truncated truncated(std::string_view text, size_t limit = 50) {
+    return Truncated{text, limit};
+}
+
+template <>
+struct fmt::formatter<Truncated> {
+    constexpr auto parse(format_parse_context& ctx) -> decltype(ctx.begin()) {
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const Truncated& value, FormatContext& ctx) const -> decltype(ctx.out()) {
+        if (value.text.size() <= value.limit) {
+            return std::copy(value.text.begin(), value.text.end(), ctx.out());
+        }
+        size_t end = value.limit;
+        while (end > 0 && (static_cast<unsigned char>(value.text[end]) & 0xC0) == 0x80) {
+            --end;
+        }
+        auto out = std::copy(value.text.begin(), value.text.begin() + end, ctx.out());
+        constexpr std::string_view ellipsis = "...";
+        return std::copy(ellipsis.begin(), ellipsis.end(), out);
+    }
+};
@@ -1,127 +1,348 @@
 #include <tgbot/tgbot.h>
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/daily_file_sink.h>
 #include <nlohmann/json.hpp>
 #include "birthday_manager.h"
 #include "gayrate_manager.h"
+#include "outbound_scheduler.h"
+#include "outbox_log.h"
+#include "rate_limiter.h"
+#include "handler_pool.h"
+#include "command_parser.h"
+#include "date_utils.h"
+#include "responses.h"
+#include "metrics.h"
+#include "chat_shards.h"
+#include "chat_settings.h"
+#include "announcement_scheduler.h"
+#include "log_sampling.h"
+#include "send_pipeline.h"
+#include "command_router.h"
+#include "data_watcher.h"
+#include "user_chats.h"
+#include "journal_store.h"
+#include <fstream>
 #include <sstream>
-#include <regex>
+#include <string_view>
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <chrono>
 #include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
-#include <unordered_map>
 #include <limits>
+#include <optional>
 
 using namespace TgBot;
 using namespace std;
 
 class BirthdayBot {
 private:
+    // TELEGRAM_API_URL направляет бота на другой сервер Bot API (например, на
+    // заглушку fake_telegram для нагрузочных прогонов). Клиент tgbot-cpp по
+    // умолчанию умеет только HTTPS, поэтому для своего адреса берется curl
+    unique_ptr<HttpClient> httpClient_ = makeHttpClient();
     Bot bot_;
-    BirthdayManager birthday_manager_;
-    GayRateManager gayrate_manager_;
+    // Данные каждого чата - отдельный шард со своим мьютексом и файлом
+    ChatShards<BirthdayManager> birthdays_{"birthdays"};
+    ChatShards<GayRateManager> gayrates_{"gayrates"};
+    // Подписки чатов на ежедневные поздравления
+    ChatSettings chatSettings_{"chats.json"};
     shared_ptr<spdlog::logger> logger_;
 
-    // Очередь отправки сообщений (не блокирует обработчики). Глобальный воркер соблюдает задержки per-chat
-    struct PendingMessage { int64_t chatId; string text; };
-    mutex queueMutex_;
-    condition_variable queueCv_;
-    deque<PendingMessage> messageQueue_;
-    unordered_map<int64_t, chrono::steady_clock::time_point> chatNextAllowed_;
-    chrono::seconds baseDelay_{4};
+    // Планировщик отправки сообщений (не блокирует обработчики): очередь на каждый чат,
+    // лимиты Telegram - ведра токенов на бота и на чат, воркер спит только до
+    // ближайшего чата, которому уже можно писать
+    OutboundScheduler outbound_;
     thread worker_;
-    atomic<bool> stopWorker_{false};
+    // Копия очереди на диске: неподтвержденные сообщения отправляются после перезапуска
+    OutboxLog outbox_{"outbox"};
+
+    // Ошибки, кроме 429: повтор с удвоением паузы, после kMaxSendAttempts - в dead.log
+    static constexpr int kMaxSendAttempts = 5;
+    static constexpr chrono::seconds kRetryBaseDelay{5};
+    static constexpr chrono::seconds kRetryMaxDelay{300};
+
+    // Метрики: ссылки берутся один раз, запись на горячем пути - только атомики
+    MetricsRegistry& metrics_ = MetricsRegistry::instance();
+    Histogram& sendSeconds_ = metrics_.histogram("bot_send_seconds",
+        "sendMessage round-trip time", latencyBuckets());
+    Counter& messagesSent_ = metrics_.counter("bot_messages_sent_total", "Messages delivered to Telegram");
+    Counter& messagesCoalesced_ = metrics_.counter("bot_messages_coalesced_total",
+        "Queued messages merged into a preceding sendMessage call");
+    Counter& sendErrors_ = metrics_.counter("bot_send_errors_total", "Failed sendMessage calls");
+    Counter& rateLimited_ = metrics_.counter("bot_send_rate_limited_total", "429 Too Many Requests responses");
+    Histogram& retryAfter_ = metrics_.histogram("bot_send_retry_after_seconds",
+        "retry after values parsed from 429 responses", retryAfterBuckets());
+    Counter& announcements_ = metrics_.counter("bot_announcements_total", "Daily birthday announcements enqueued");
+    Counter& deadLetters_ = metrics_.counter("bot_outbox_dead_letters_total",
+        "Messages given up on and written to outbox/dead.log");
+
+    // Вызовы sendMessage идут через пул постоянных соединений: в полете до
+    // SEND_CONNECTIONS сообщений в разные чаты, темп задают лимиты, а не время ответа API
+    SendPipeline pipeline_;
+    // Сколько ждать ответов на отправленные сообщения при остановке
+    static constexpr chrono::seconds kSendDrainTimeout{5};
 
     void startSenderWorker() {
-        stopWorker_ = false;
+        pipeline_.start();
         worker_ = thread([this]() {
-            while (!stopWorker_) {
-                PendingMessage msg;
-                {
-                    unique_lock<mutex> lock(queueMutex_);
-                    queueCv_.wait(lock, [this]{ return stopWorker_ || !messageQueue_.empty(); });
-                    if (stopWorker_) break;
-                    msg = messageQueue_.front();
-                    messageQueue_.pop_front();
-                }
-
-                // Проверяем per-chat окно
-                auto now = chrono::steady_clock::now();
-                auto it = chatNextAllowed_.find(msg.chatId);
-                if (it != chatNextAllowed_.end() && it->second > now) {
-                    // Еще рано отправлять: вернем сообщение в конец и подождем немного, не блокируя другие чаты
-                    {
-                        lock_guard<mutex> lock(queueMutex_);
-                        messageQueue_.push_back(msg);
-                        this_thread::sleep_for(baseDelay_);
-                    }
-                    this_thread::sleep_for(chrono::milliseconds(100));
-                    continue;
-                }
-
-                // Пытаемся отправить
-                try {
-                    bot_.getApi().sendMessage(msg.chatId, msg.text);
-                    this_thread::sleep_for(baseDelay_);
-                    logger_->debug("Message sent to chat {}: {}", msg.chatId, msg.text.substr(0, 50) + "...");
-                    // Устанавливаем следующее доступное время для чата
-                    chatNextAllowed_[msg.chatId] = chrono::steady_clock::now() + baseDelay_;
-                } catch (const TgException& e) {
-                    const string errorMsg = e.what();
-                    logger_->error("Failed to send message to chat {}: {}", msg.chatId, errorMsg);
-                    // Обработка 429: извлекаем retry after и планируем повтор
-                    if (errorMsg.find("Too Many Requests") != string::npos) {
-                        size_t pos = errorMsg.find("retry after ");
-                        int waitSec = 60; // по умолчанию
-                        if (pos != string::npos) {
-                            try {
-                                waitSec = stoi(errorMsg.substr(pos + 12));
-                            } catch (...) {
-                                waitSec = 60;
-                            }
-                        }
-                        logger_->warn("Rate limited for chat {}. Waiting {}s before retry.", msg.chatId, waitSec);
-                        chatNextAllowed_[msg.chatId] = chrono::steady_clock::now() + chrono::seconds(waitSec + 1);
-                        // Переочередим сообщение в конец очереди, чтобы не блокировать другие чаты
-                        {
-                            lock_guard<mutex> lock(queueMutex_);
-                            messageQueue_.push_back(msg);
-                        }
-                        // Короткий сон, чтобы не крутиться в холостую
-                        this_thread::sleep_for(chrono::milliseconds(100));
-                    } else {
-                        // Прочие ошибки: легкий backoff и повторная постановка
-                        chatNextAllowed_[msg.chatId] = chrono::steady_clock::now() + chrono::seconds(5);
-                        {
-                            lock_guard<mutex> lock(queueMutex_);
-                            messageQueue_.push_back(msg);
-                        }
-                        this_thread::sleep_for(chrono::milliseconds(50));
-                    }
-                }
+            OutboundMessage msg;
+            // Сообщение берется из планировщика, только когда есть свободное соединение:
+            // иначе оно ждало бы в очереди конвейера, а не в своем чате
+            while (pipeline_.waitForSlot() && outbound_.next(msg)) {
+                const auto sendStart = chrono::steady_clock::now();
+                const int64_t chatId = msg.chatId;
+                const string text = msg.text;
+                pipeline_.sendMessage(chatId, text, [this, msg = move(msg), sendStart](SendResult result) mutable {
+                    onSendResult(move(msg), result, chrono::steady_clock::now() - sendStart);
+                });
             }
         });
     }
 
+    // Завершение вызова sendMessage (в потоке конвейера): обновить лимиты и очередь
+    void onSendResult(OutboundMessage msg, const SendResult& result, chrono::steady_clock::duration elapsed) {
+        if (result.aborted) {
+            // Остановка: сообщение осталось неподтвержденным в outbox и уйдет после перезапуска
+            return;
+        }
+        sendSeconds_.observe(elapsed);
+        if (result.ok) {
+            messagesSent_.inc();
+            messagesCoalesced_.inc(msg.parts - 1);
+            logger_->debug("Message sent to chat {} ({} parts): {}", msg.chatId, msg.parts, truncated(msg.text));
+            outbox_.ack(msg.ids);
+            outbound_.complete(msg.chatId);
+            return;
+        }
+
+        sendErrors_.inc();
+        LOG_SAMPLED(logger_, spdlog::level::err, kErrorLogLimit, "Failed to send message to chat {}: {}", msg.chatId, result.description);
+        if (result.errorCode == 429 || result.retryAfter) {
+            // 429: чат ждет retry after (+1 секунда про запас) и дальше пишется медленнее
+            const auto wait = result.retryAfter.value_or(chrono::seconds(60)) + chrono::seconds(1);
+            rateLimited_.inc();
+            retryAfter_.observe(static_cast<double>(wait.count() - 1));
+            LOG_SAMPLED(logger_, spdlog::level::warn, kErrorLogLimit, "Rate limited for chat {}. Waiting {}s before retry.", msg.chatId, wait.count());
+            // Сообщение возвращается в голову очереди своего чата, остальные чаты не ждут
+            outbound_.rateLimited(move(msg), wait);
+        } else if (result.errorCode == 400 || result.errorCode == 403) {
+            // Чат удален, бот заблокирован, текст не принят - повтор не поможет
+            deadLetter(msg, result.description);
+        } else {
+            // Сеть, таймаут, 5xx
+            retryOrDeadLetter(move(msg), result.description);
+        }
+    }
+
+    void retryOrDeadLetter(OutboundMessage msg, const string& error) {
+        if (++msg.attempts >= kMaxSendAttempts) {
+            deadLetter(msg, error);
+            return;
+        }
+        const auto delay = min(kRetryBaseDelay * (1 << (msg.attempts - 1)), kRetryMaxDelay);
+        outbound_.retry(move(msg), chrono::steady_clock::now() + delay);
+    }
+
+    void deadLetter(const OutboundMessage& msg, const string& error) {
+        logger_->warn("Giving up on message to chat {} (attempts: {}): {}", msg.chatId, msg.attempts, error);
+        deadLetters_.inc();
+        outbox_.deadLetter(msg, error);
+        outbound_.complete(msg.chatId);
+    }
+
+    // Вернуть в очередь сообщения, не подтвержденные до прошлой остановки
+    void restoreOutbox() {
+        auto records = outbox_.recover();
+        for (auto& record : records) {
+            outbound_.enqueue(record.chatId, move(record.text), record.priority, record.id);
+        }
+        if (!records.empty()) {
+            logger_->info("Restored {} undelivered messages from outbox", records.size());
+        }
+    }
+
     void stopSenderWorker() {
-        stopWorker_ = true;
-        queueCv_.notify_all();
+        outbound_.stop();
+        // Ответы на уже отправленные сообщения еще подтвердят их в outbox;
+        // неподтвержденные уйдут после перезапуска
+        pipeline_.drain(kSendDrainTimeout);
+        pipeline_.stop();
         if (worker_.joinable()) worker_.join();
     }
 
-    void enqueueMessage(int64_t chatId, const string& text) {
-        {
-            lock_guard<mutex> lock(queueMutex_);
-            messageQueue_.push_back(PendingMessage{chatId, text});
+    void enqueueMessage(int64_t chatId, const string& text,
+                        MessagePriority priority = MessagePriority::Interactive) {
+        outbound_.enqueue(chatId, text, priority, outbox_.append(chatId, text, priority));
+    }
+
+    // Метрики команды из kCommands: ссылки берутся один раз при запуске
+    struct RouteMetrics {
+        Histogram* latency;
+        Histogram* queueWait;
+    };
+    vector<RouteMetrics> routeMetrics_;
+    // Чаты пользователей для инлайн-запросов
+    UserChats userChats_;
+    Histogram& inlineSeconds_ = metrics_.histogram("bot_inline_query_seconds",
+        "Inline query handling time including answerInlineQuery", latencyBuckets());
+
+    // Лимиты команд на пользователя и на чат, проверяются до очереди пула
+    FloodGuard flood_;
+    Counter& commandsDropped_ = metrics_.counter("bot_commands_dropped_total",
+        "Commands dropped by per-user and per-chat flood limits");
+
+    // Обработчики команд выполняются в пуле, а не в потоке long polling:
+    // обновления одного чата идут по порядку, разных чатов - параллельно.
+    //
+    // Члены разрушаются в обратном порядке: наблюдатель за файлами,
+    // поздравления, выгрузка метрик, пул, затем все, что объявлено выше.
+    // Наблюдатель и поздравления объявлены после пула: их колбэки в своих
+    // потоках, как и задачи пула, меняют шарды и ставят сообщения в очередь
+    // отправки, поэтому они останавливаются первыми - пока пул дорабатывает
+    // задачи, новых изменений со стороны не появляется. Все, чем пользуются
+    // колбэки, задачи пула и gauge-колбэки метрик, объявлено выше и живет дольше
+    HandlerPool handlers_{handlerThreads(), 256};
+    MetricsFileWriter metricsWriter_{metricsFile(), chrono::seconds(15)};
+    // Поздравления уходят в очередь с приоритетом Bulk и не задерживают ответы на команды
+    AnnouncementScheduler announcer_{chatSettings_,
+        [this](int64_t chatId, int day, int month, int year) { announceBirthdays(chatId, day, month, year); }};
+
+    // Правка <каталог>/<chatId>.json снаружи (например, через том с данными)
+    // применяется без перезапуска: файл разбирается в потоке наблюдателя, в
+    // хранилище попадают только отличия от текущего состояния. Бот сам этот
+    // файл не обновляет, поэтому файл старше данных чата не применяется - он
+    // откатил бы изменения, сделанные после выгрузки
+    DataWatcher dataWatcher_{{birthdays_.dir(), gayrates_.dir()},
+        [this](const string& dir, int64_t chatId) { reloadShard(dir, chatId); }};
+    Counter& dataReloads_ = metrics_.counter("bot_data_reloads_total",
+        "Externally edited data files applied without restart");
+
+    void reloadShard(const string& dir, int64_t chatId) {
+        const string path = chatShardPath(dir, chatId);
+        if (!jsonNewerThanStore(path)) {
+            // Так выглядит и свежая выгрузка birthday_snapshot export: ее время
+            // изменения равно времени данных, из которых она сделана
+            logger_->info("Skipping reload of {}: the file is not newer than the chat's data "
+                          "(unedited export or stale copy)", path);
+            return;
         }
-        queueCv_.notify_one();
+        optional<ReloadStats> stats;
+        if (dir == birthdays_.dir()) {
+            if (auto records = RecordStore<BirthdaySchema>::readJson(path)) {
+                stats = birthdays_.get(chatId).replaceAll(move(*records));
+            }
+        } else if (auto records = RecordStore<GayRateSchema>::readJson(path)) {
+            stats = gayrates_.get(chatId).replaceAll(move(*records));
+        }
+        if (!stats) {
+            logger_->warn("Cannot reload {}: file is missing or not a JSON object", path);
+            return;
+        }
+        if (stats->empty()) {
+            logger_->debug("Reloaded {}: no changes", path);
+            return;
+        }
+        dataReloads_.inc();
+        logger_->info("Reloaded {}: {} added, {} changed, {} removed", path, stats->added, stats->changed, stats->removed);
+    }
+
+    void announceBirthdays(int64_t chatId, int day, int month, int year) {
+        const auto birthdays = birthdays_.get(chatId).getBirthdaysOn(day, month, year);
+        if (birthdays.empty()) {
+            return;
+        }
+        enqueueMessage(chatId, renderBirthdayAnnouncement(birthdays), MessagePriority::Bulk);
+        announcements_.inc();
+        logger_->info("Announced {} birthdays in chat {}", birthdays.size(), chatId);
+    }
+
+    static string metricsFile() {
+        const char* env = getenv("METRICS_FILE");
+        return env ? env : "metrics.prom";
+    }
+
+    void setupMetrics() {
+        metrics_.gaugeCallback("bot_outbound_queue_depth", "Messages waiting in the outbound scheduler",
+            [this] { return static_cast<double>(outbound_.size()); });
+        metrics_.gaugeCallback("bot_outbound_oldest_message_age_seconds", "Age of the oldest queued outbound message",
+            [this] { return chrono::duration<double>(outbound_.oldestAge()).count(); });
+        metrics_.gaugeCallback("bot_outbox_pending", "Messages in the outbox not yet acknowledged",
+            [this] { return static_cast<double>(outbox_.pending()); });
+        metrics_.gaugeCallback("bot_send_in_flight", "sendMessage calls awaiting a response",
+            [this] { return static_cast<double>(pipeline_.inFlight()); });
+        metrics_.gaugeCallback("bot_rate_limited_chats", "Chats with tracked send limits",
+            [this] { return static_cast<double>(outbound_.limitedChats()); });
+        metrics_.gaugeCallback("bot_rate_throttled_chats", "Chats sending slower after a 429 response",
+            [this] { return static_cast<double>(outbound_.throttledChats()); });
+        metrics_.gaugeCallback("bot_log_overruns", "Log records dropped because the async log queue was full",
+            [] { return static_cast<double>(spdlog::thread_pool()->overrun_counter()); });
+        metrics_.gaugeCallback("bot_inline_known_users", "Users whose chats are known for inline queries",
+            [this] { return static_cast<double>(userChats_.size()); });
+        metrics_.gaugeCallback("bot_flood_tracked_keys", "Users and chats with flood limit state",
+            [this] { return static_cast<double>(flood_.trackedKeys()); });
+        metrics_.gaugeCallback("bot_handler_queue_depth", "Updates waiting for a handler thread",
+            [this] { return static_cast<double>(handlers_.size()); });
+        metrics_.gaugeCallback("bot_chat_shards", "Chats with loaded data",
+            [this] { return static_cast<double>(birthdays_.size()); }, "store=\"birthdays\"");
+        metrics_.gaugeCallback("bot_chat_shards", "Chats with loaded data",
+            [this] { return static_cast<double>(gayrates_.size()); }, "store=\"gayrates\"");
+    }
+
+    // Старые версии хранили один общий birthdays.json и GayRates.json на все чаты.
+    // LEGACY_CHAT_ID указывает, какому чату они достаются при переходе на шарды
+    void migrateLegacyData() {
+        const char* env = getenv("LEGACY_CHAT_ID");
+        if (!env || !*env) {
+            if (ifstream("birthdays.json") || ifstream("GayRates.json")) {
+                logger_->warn("Found legacy birthdays.json/GayRates.json; set LEGACY_CHAT_ID to move them into a chat");
+            }
+            return;
+        }
+        const int64_t chat_id = atoll(env);
+        if (migrateLegacyStore("birthdays.json", chatShardPath(birthdays_.dir(), chat_id))) {
+            logger_->info("Moved legacy birthdays.json to chat {}", chat_id);
+        }
+        if (migrateLegacyStore("GayRates.json", chatShardPath(gayrates_.dir(), chat_id))) {
+            logger_->info("Moved legacy GayRates.json to chat {}", chat_id);
+        }
+    }
+
+    static size_t handlerThreads() {
+        if (const char* env = getenv("HANDLER_THREADS")) {
+            int threads = atoi(env);
+            if (threads > 0) return static_cast<size_t>(threads);
+        }
+        return clamp<size_t>(thread::hardware_concurrency(), 2, 8);
+    }
+
+    // Сколько записей в секунду допускается с одного места в коде: команды
+    // на входе и ошибки отправки (при сбое сети они идут на каждое сообщение)
+    static constexpr uint32_t kCommandLogLimit = 20;
+    static constexpr uint32_t kErrorLogLimit = 5;
+
+    // Размер очереди асинхронного логгера (записей)
+    static size_t logQueueSize() {
+        const char* env = getenv("LOG_QUEUE_SIZE");
+        auto size = env ? parseInt(env) : nullopt;
+        return size && *size > 0 ? static_cast<size_t>(*size) : 8192;
+    }
+
+    // LOG_OVERFLOW=block - при полной очереди ждать; по умолчанию вытесняется
+    // самая старая запись, и логирование никогда не задерживает обработчики
+    static spdlog::async_overflow_policy logOverflowPolicy() {
+        const char* env = getenv("LOG_OVERFLOW");
+        return env && string_view(env) == "block" ? spdlog::async_overflow_policy::block
+                                                  : spdlog::async_overflow_policy::overrun_oldest;
     }
 
     void setupLogger() {
+        // Записи форматируются в вызывающем потоке и кладутся в ограниченную
+        // кольцевую очередь; в консоль и файл пишет отдельный поток пула
+        spdlog::init_thread_pool(logQueueSize(), 1);
+
         // Создаем консольный логгер с цветами
         auto console_sink = make_shared<spdlog::sinks::stdout_color_sink_mt>();
         console_sink->set_level(spdlog::level::info);
@@ -132,8 +353,12 @@ private:
 
         // Создаем мульти-синк логгер
         vector<spdlog::sink_ptr> sinks {console_sink, file_sink};
-        logger_ = make_shared<spdlog::logger>("birthday_bot", sinks.begin(), sinks.end());
+        logger_ = make_shared<spdlog::async_logger>("birthday_bot", sinks.begin(), sinks.end(),
+                                                    spdlog::thread_pool(), logOverflowPolicy());
         logger_->set_level(spdlog::level::debug);
+        // Сброс файла - тоже задача потока пула, а не вызывающего
+        logger_->flush_on(spdlog::level::warn);
+        spdlog::flush_every(chrono::seconds(1));
 
         // Устанавливаем паттерн логирования
         logger_->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [%t] %v");
@@ -142,325 +367,515 @@ private:
         spdlog::set_default_logger(logger_);
     }
 
-    void setupCommands() {
-        // Команда /dr N - показать ближайшие дни рождения
-        bot_.getEvents().onCommand("dr", [this](Message::Ptr message) {
-            logger_->info("Received /dr command from user: {}", message->from->username);
+    // Дата существует, не раньше 1900 года и не позже today
+    static bool isAcceptableBirthday(const ParsedDate& date, const CivilDate& today) {
+        if (date.year < 1900 || !isValidDate(date.day, date.month, date.year)) {
+            return false;
+        }
+        return daysFromCivil(date.year, date.month, date.day) <= daysFromCivil(today);
+    }
 
-            if (message->from->username == "Decstercense"
-                || message->from->username == "Zaya_vokahksi") {
-                    enqueueMessage(message->chat->id, "Я для тя слишком дахуя спамлю, поэтому для тя команда /imgay нахуй");
-                }
+    // Сегодняшняя дата в часовом поясе чата (без /tz - в поясе сервера)
+    CivilDate chatToday(int64_t chatId) {
+        return todayAt(chatSettings_.utcOffset(chatId).value_or(localUtcOffset()));
+    }
 
-            // Небольшая задержка перед обработкой команды
-            this_thread::sleep_for(chrono::milliseconds(500));
+    // "UTC+3", "UTC-5:30", "UTC"
+    static string utcOffsetName(chrono::minutes offset) {
+        const auto minutes = offset.count();
+        if (minutes == 0) {
+            return "UTC";
+        }
+        const auto absolute = minutes < 0 ? -minutes : minutes;
+        string name = string("UTC") + (minutes < 0 ? "-" : "+") + to_string(absolute / 60);
+        if (absolute % 60 != 0) {
+            name += (absolute % 60 < 10 ? ":0" : ":") + to_string(absolute % 60);
+        }
+        return name;
+    }
 
-            string text = message->text;
-            int days = 365; // По умолчанию 365 дней
+    // Размер топа из "/gaytop K": по умолчанию 10, не больше 100.
+    // nullopt - K неверный, ответ с ошибкой уже поставлен в очередь
+    optional<size_t> topSize(const Message::Ptr& message) {
+        CommandArgs args(message->text);
+        const auto token = args.next();
+        if (token.empty()) {
+            return 10;
+        }
+        auto k = parseInt(token);
+        if (!k || *k == 0 || *k > 100) {
+            enqueueMessage(message->chat->id, "Ошибка: K должно быть от 1 до 100");
+            return nullopt;
+        }
+        return static_cast<size_t>(*k);
+    }
 
-            // Парсим параметр N
-            regex dr_regex(R"(/dr\s+(\d+))");
-            smatch match;
-            if (regex_search(text, match, dr_regex)) {
-                days = stoi(match[1].str());
-                if (days > 365) {
-                    enqueueMessage(message->chat->id, "Ошибка: N не может быть больше 365 дней");
-                    return;
-                }
-            }
+    // Место автора команды, если он не попал в показанный топ
+    static optional<OwnRank> ownRank(GayRateManager& gayrates, const string& nickname,
+                                     bool by_grazd, size_t shown) {
+        auto rank = gayrates.getGayRank(nickname, by_grazd);
+        if (!rank || *rank < shown) {
+            return nullopt;
+        }
+        const auto info = gayrates.getGayInfo(nickname);
+        return OwnRank{nickname, by_grazd ? info.grazd : info.gayness, *rank, gayrates.getGayCount()};
+    }
 
-            auto upcoming = birthday_manager_.getUpcomingBirthdays(days);
+    // Команда /dr N - показать ближайшие дни рождения
+    void handleDr(const Message::Ptr& message) {
+        int days = 365; // По умолчанию 365 дней
 
-            if (upcoming.empty()) {
-                enqueueMessage(message->chat->id,
-                    "В ближайшие " + to_string(days) + " дней дней рождения не найдено.");
+        // Парсим параметр N
+        CommandArgs args(message->text);
+        if (auto n = parseInt(args.next())) {
+            days = *n;
+            if (days > 365) {
+                enqueueMessage(message->chat->id, "Ошибка: N не может быть больше 365 дней");
                 return;
             }
+        }
 
-            stringstream response;
-            response << "🎂 Дни рождения в ближайшие " << days << " дней:\n\n";
+        const CivilDate today = chatToday(message->chat->id);
+        auto upcoming = birthdays_.get(message->chat->id).getUpcomingBirthdays(days, today);
 
-            for (const auto& [info, age] : upcoming) {
-                // Вычисляем количество дней до дня рождения
-                auto now = chrono::system_clock::now();
-                auto time_t = chrono::system_clock::to_time_t(now);
-                auto current_tm = *localtime(&time_t);
+        enqueueMessage(message->chat->id, renderUpcomingBirthdays(days, upcoming, today));
+    }
 
-                int current_day = current_tm.tm_mday;
-                int current_month = current_tm.tm_mon + 1;
-                int current_year = current_tm.tm_year + 1900;
+    void handleImgay(const Message::Ptr& message) {
+        enqueueMessage(message->chat->id, "Наебал, ты теперь GAY АХАХАХХАХАХА");
+    }
 
-                int next_birthday_year = current_year;
-                if (current_month > info.month || (current_month == info.month && current_day > info.day)) {
-                    next_birthday_year++;
-                }
+    void handleKek(const Message::Ptr& message) {
+        enqueueMessage(message->chat->id, "Аяз далбаёб АХАХХАХАХА");
+    }
 
-                tm birthday_tm = {};
-                birthday_tm.tm_year = next_birthday_year - 1900;
-                birthday_tm.tm_mon = info.month - 1;
-                birthday_tm.tm_mday = info.day;
-                birthday_tm.tm_hour = 0;
-                birthday_tm.tm_min = 0;
-                birthday_tm.tm_sec = 0;
-
-                auto birthday_time = mktime(&birthday_tm);
-                auto current_time = mktime(&current_tm);
-
-                int days_until = (birthday_time - current_time) / (24 * 60 * 60);
-                if (days_until < 0) days_until = 0;
-
-                response << "👤 " << info.nickname << " - " << info.day << "." << info.month;
-                if (current_month == info.month && current_day == info.day) {
-                    response << " (СЕГОДНЯ!)";
-                } else if ((current_day + 1 == info.day)
-                    || (current_day >= 30 && info.day == 1 && (current_month + 1) % 12 == info.month)) {
-                    response << " (завтра)";
-                } else {
-                    if (days_until%10 == 1) {
-                        response << " (через " << days_until << " день)";
-                    } else if (days_until%10 >= 2 && days_until%10 <= 4) {
-                        response << " (через " << days_until << " дня)";
-                    } else {
-                        response << " (через " << days_until << " дней)";
-                    }
-                }
-                response << " - исполнится " << age << " лет\n";
-            }
+    void handleHi(const Message::Ptr& message) {
+        enqueueMessage(message->chat->id, message->from->username + " приветствует Азма!");
+    }
 
-            enqueueMessage(message->chat->id, response.str());
-        });
+    void handleLol(const Message::Ptr& message) {
+        enqueueMessage(message->chat->id, "IM GAY IM SO GAY GIVE ME COCK!!!");
+    }
 
-        bot_.getEvents().onCommand("imgay", [this](Message::Ptr message) {
-            logger_->info("Received /imgay command from user: {}", message->from->username);
-            enqueueMessage(message->chat->id, "Наебал, ты теперь GAY АХАХАХХАХАХА");
-        });
+    void handleGrazd(const Message::Ptr& message) {
+        int gayness = rand() % 100;
+        if (gayness > 30 && message->from->username == "Zaya_vokahksi") {
+            gayness = 100;
+        }
+        if (gayness < 100 && message->from->username == "WalkerGabi") {
+            gayness = 0;
+        }
+        gayrates_.get(message->chat->id).setGrazd(message->from->username, gayness);
+        enqueueMessage(message->chat->id, renderGrazdRoll(message->from->username, gayness));
+    }
 
-        bot_.getEvents().onCommand("kek", [this](Message::Ptr message) {
-            logger_->info("Received /kek command from user: {}", message->from->username);
-            enqueueMessage(message->chat->id, "Аяз далбаёб АХАХХАХАХА");
-        });
+    void handleGay(const Message::Ptr& message) {
+        int gayness = rand() % 100;
+        if (message->from->username == "Decstercense" || message->from->username == "Zaya_vokahksi") {
+            gayness = 100;
+        }
+        gayrates_.get(message->chat->id).setGayness(message->from->username, gayness);
+        enqueueMessage(message->chat->id, renderGayRoll(message->from->username, gayness));
+    }
 
-        bot_.getEvents().onCommand("hi", [this](Message::Ptr message) {
-            logger_->info("Received /hi command from user: {}", message->from->username);
-            enqueueMessage(message->chat->id, message->from->username + " приветствует Азма!");
-        });
+    void handleGayTop(const Message::Ptr& message) {
+        auto limit = topSize(message);
+        if (!limit) {
+            return;
+        }
+        auto& gayrates = gayrates_.get(message->chat->id);
+        const auto ratings = gayrates.getTopGayRates(false, *limit);
+        const auto own = ownRank(gayrates, message->from->username, false, ratings.size());
+        enqueueMessage(message->chat->id, renderRatingTop(ratings, false, own));
+    }
 
-        bot_.getEvents().onCommand("lol", [this](Message::Ptr message) {
-            logger_->info("Received /lol command from user: {}", message->from->username);
-            enqueueMessage(message->chat->id, "IM GAY IM SO GAY GIVE ME COCK!!!");
-        });
+    void handleGrazdTop(const Message::Ptr& message) {
+        auto limit = topSize(message);
+        if (!limit) {
+            return;
+        }
+        auto& gayrates = gayrates_.get(message->chat->id);
+        const auto ratings = gayrates.getTopGayRates(true, *limit);
+        const auto own = ownRank(gayrates, message->from->username, true, ratings.size());
+        enqueueMessage(message->chat->id, renderRatingTop(ratings, true, own));
+    }
 
-        bot_.getEvents().onCommand("grazd", [this](Message::Ptr message) {
-            logger_->info("Received /grazd command from user: {}", message->from->username);
-            stringstream response;
-            int gayness = rand() % 100;
-            if (gayness > 30 && message->from->username == "Zaya_vokahksi") {
-                gayness = 100;
-            }
-            if (gayness < 100 && message->from->username == "WalkerGabi") {
-                gayness = 0;
-            }
-            if (gayness <= 10) {
-                response << message->from->username << " гражданский на " << gayness << "%, ты походу не гражданский! 🪖🪖🪖";
-            } else if (gayness <= 25) {
-                response << message->from->username << " гражданский на " << gayness << "%! 💼";
-            } else if (gayness <= 50) {
-                response << message->from->username << " гражданский на " << gayness << "%! 💼💼";
-            } else if (gayness <= 75) {
-                response << message->from->username << " гражданский на " << gayness << "%! 💼💼💼";
-            } else if (gayness <= 99) {
-                response << message->from->username << " гражданский на " << gayness << "%! 💼💼💼💼";
-            } else {
-                response << message->from->username << " гражданский на " << gayness << "%! Ты походу сосёшь хуй 💼💼💼💼💼💼💼";
-            }
-            auto gay = gayrate_manager_.getGayInfo(message->from->username);
-            gayrate_manager_.addGayRate(message->from->username, gayness, gay.gayness);
-            enqueueMessage(message->chat->id, response.str());
-        });
+    void handleRand(const Message::Ptr& message) {
+        auto upcoming = birthdays_.get(message->chat->id).getUpcomingBirthdays();
+        stringstream response;
+        if (upcoming.empty()) {
+            enqueueMessage(message->chat->id, "В этом чате пока нет дней рождения, добавьте их через /add");
+            return;
+        }
+        response << "🎂 Выпал этот далбаёб " << upcoming[rand() % upcoming.size()].first.nickname;
+        enqueueMessage(message->chat->id, response.str());
+    }
 
-        bot_.getEvents().onCommand("gay", [this](Message::Ptr message) {
-            logger_->info("Received /gay command from user: {}", message->from->username);
-            stringstream response;
-            int gayness = rand() % 100;
-            if (message->from->username == "Decstercense" || message->from->username == "Zaya_vokahksi") {
-                gayness = 100;
-            }
-            if (gayness <= 25) {
-                response << message->from->username << " на " << gayness << "% GAY!🏳️‍🌈";
-            } else if (gayness <= 50) {
-                response << message->from->username << " на " << gayness << "% GAY!🏳️‍🌈🏳️‍🌈";
-            } else if (gayness <= 75) {
-                response << message->from->username << " на " << gayness << "% GAY!🏳️‍🌈🏳️‍🌈🏳️‍🌈";
-            } else if (gayness <= 99) {
-                response << message->from->username << " на " << gayness << "% GAY!🏳️‍🌈🏳️‍🌈🏳️‍🌈🏳️‍🌈";
-            } else {
-                response << message->from->username << " на " << gayness << "% GAY!🏳️‍🌈🏳️‍🌈🏳️‍🌈🏳️‍🌈🏳️‍🌈 Ты походу тут самый гейский пидарас, снимай штаны";
-            }
-            auto gay = gayrate_manager_.getGayInfo(message->from->username);
-            gayrate_manager_.addGayRate(message->from->username, gay.grazd, gayness);
-            enqueueMessage(message->chat->id, response.str());
-        });
+    // Команды /subscribe и /unsubscribe - ежедневные поздравления в этом чате
+    void handleSubscribe(const Message::Ptr& message) {
+        chatSettings_.setSubscribed(message->chat->id, true);
+        enqueueMessage(message->chat->id, "🔔 Теперь каждый день в полночь я буду поздравлять именинников этого чата"
+            " (часовой пояс чата - /tz)");
+    }
 
-        bot_.getEvents().onCommand("gaytop", [this](Message::Ptr message) {
-            logger_->info("Received /gaytop command from user: {}", message->from->username);
-            stringstream response;
-            const auto ratings = gayrate_manager_.getTopGayRates(false);
-            if (ratings.empty()) {
-                response << "Пока здесь педиков нет, но это ненадолго\n";
-            } else {
-                response << "👤🏆🏆🏆 Главный пидарас - " << ratings[0].nickname << " - " << ratings[0].gayness << ", поздравляем! 🏆🏆🏆\n";
-                for (size_t i = 1; i < ratings.size(); ++i) {
-                    response << "👤 " << ratings[i].nickname << " - " << ratings[i].gayness << '\n';
-                }
-                enqueueMessage(message->chat->id, response.str());
-            }
-        });
+    void handleUnsubscribe(const Message::Ptr& message) {
+        chatSettings_.setSubscribed(message->chat->id, false);
+        enqueueMessage(message->chat->id, "🔕 Ежедневные поздравления в этом чате отключены");
+    }
 
-        bot_.getEvents().onCommand("grazdtop", [this](Message::Ptr message) {
-            logger_->info("Received /grazdtop command from user: {}", message->from->username);
-            stringstream response;
-            const auto ratings = gayrate_manager_.getTopGayRates(true);
-            if (ratings.empty()) {
-                response << "Пока здесь гражданских нет, ахуели?\n";
-            } else {
-                response << "👤💼 Главный гражданский - " << ratings[0].nickname << " - " << ratings[0].grazd << ", поздравляем! 💼\n";
-                for (size_t i = 1; i < ratings.size(); ++i) {
-                    response << "👤 " << ratings[i].nickname << " - " << ratings[i].grazd << '\n';
-                }
-                enqueueMessage(message->chat->id, response.str());
-            }
-        });
+    // Команда /tz [смещение|reset] - часовой пояс чата для /dr, /add и поздравлений
+    void handleTz(const Message::Ptr& message) {
+        const int64_t chatId = message->chat->id;
+        CommandArgs args(message->text);
+        const auto token = args.next();
+        if (token.empty()) {
+            const auto offset = chatSettings_.utcOffset(chatId);
+            enqueueMessage(chatId, offset
+                ? "🕰 Часовой пояс чата: " + utcOffsetName(*offset)
+                : "🕰 Часовой пояс чата не задан, используется пояс сервера: " + utcOffsetName(localUtcOffset()));
+            return;
+        }
+        if (token == "reset") {
+            chatSettings_.setUtcOffset(chatId, nullopt);
+            enqueueMessage(chatId, "🕰 Часовой пояс чата сброшен на пояс сервера: " + utcOffsetName(localUtcOffset()));
+            return;
+        }
+        auto minutes = parseUtcOffset(token);
+        if (!minutes || *minutes < kMinUtcOffsetMinutes || *minutes > kMaxUtcOffsetMinutes || !args.empty()) {
+            enqueueMessage(chatId,
+                "Ошибка: Укажите смещение от UTC от -12 до +14, например: /tz +3 или /tz +5:30\n"
+                "/tz reset - вернуть часовой пояс сервера");
+            return;
+        }
+        chatSettings_.setUtcOffset(chatId, chrono::minutes(*minutes));
+        enqueueMessage(chatId, "✅ Часовой пояс чата: " + utcOffsetName(chrono::minutes(*minutes)));
+    }
 
-        bot_.getEvents().onCommand("rand", [this](Message::Ptr message) {
-            logger_->info("Received /rand command from user: {}", message->from->username);
-            auto upcoming = birthday_manager_.getUpcomingBirthdays();
-            stringstream response;
-            response << "🎂 Выпал этот далбаёб " << upcoming[rand() % upcoming.size()].first.nickname;
-            enqueueMessage(message->chat->id, response.str());
-        });
-            // Команда /add day.month.year - добавить свой день рождения
-        bot_.getEvents().onCommand("add", [this](Message::Ptr message) {
-            logger_->info("Received /add command from user: {}", message->from->username);
+    // Команда /add day.month.year - добавить свой день рождения
+    void handleAdd(const Message::Ptr& message) {
+        string username = message->from->username;
 
-            // Небольшая задержка перед обработкой команды
-            this_thread::sleep_for(chrono::milliseconds(500));
+        if (username.empty()) {
+            enqueueMessage(message->chat->id,
+                "Ошибка: У вас не установлен username в Telegram. Пожалуйста, установите username в настройках профиля.");
+            return;
+        }
 
-            string text = message->text;
-            string username = message->from->username;
+        // Парсим команду: /add day.month.year или /add nickname day.month.year
+        CommandArgs args(message->text);
+        string_view first = args.next();
+        string_view second = args.next();
 
-            if (username.empty()) {
+        if (auto date = parseDate(first); date && second.empty()) {
+            // Проверяем корректность даты
+            if (!isAcceptableBirthday(*date, chatToday(message->chat->id))) {
                 enqueueMessage(message->chat->id,
-                    "Ошибка: У вас не установлен username в Telegram. Пожалуйста, установите username в настройках профиля.");
+                    "Ошибка: Некорректная дата. Используйте формат: /add день.месяц.год (например: /add 15.03.1990)");
                 return;
             }
 
-            // Парсим команду /add day.month.year
-            regex add_regex(R"(/add\s+(\d{1,2})\.(\d{1,2})\.(\d{4}))");
-            smatch match;
-
-            if (regex_search(text, match, add_regex)) {
-                int day = stoi(match[1].str());
-                int month = stoi(match[2].str());
-                int year = stoi(match[3].str());
+            birthdays_.get(message->chat->id).addBirthday(username, date->day, date->month, date->year);
+            enqueueMessage(message->chat->id,
+                "✅ Ваш день рождения " + to_string(date->day) + "." + to_string(date->month) + "." + to_string(date->year) + " успешно сохранен!");
 
-                // Проверяем корректность даты
-                if (day < 1 || day > 31 || month < 1 || month > 12 || year < 1900 || year > 2024) {
-                    enqueueMessage(message->chat->id,
-                        "Ошибка: Некорректная дата. Используйте формат: /add день.месяц.год (например: /add 15.03.1990)");
-                    return;
-                }
+            logger_->info("Added birthday for user {}: {}.{}.{}", username, date->day, date->month, date->year);
+        } else if (auto date = parseDate(second); date && isNickname(first) && args.empty()) {
+            string nickname(first);
 
-                birthday_manager_.addBirthday(username, day, month, year);
+            // Проверяем корректность даты
+            if (!isAcceptableBirthday(*date, chatToday(message->chat->id))) {
                 enqueueMessage(message->chat->id,
-                    "✅ Ваш день рождения " + to_string(day) + "." + to_string(month) + "." + to_string(year) + " успешно сохранен!");
+                    "Ошибка: Некорректная дата. Используйте формат: /add никнейм день.месяц.год (например: /add john 15.03.1990)");
+                return;
+            }
 
-                logger_->info("Added birthday for user {}: {}.{}.{}", username, day, month, year);
-            } else {
-                // Парсим команду /add nickname day.month.year
-                regex add_nickname_regex(R"(/add\s+(\w+)\s+(\d{1,2})\.(\d{1,2})\.(\d{4}))");
-                if (regex_search(text, match, add_nickname_regex)) {
-                    string nickname = match[1].str();
-                    int day = stoi(match[2].str());
-                    int month = stoi(match[3].str());
-                    int year = stoi(match[4].str());
-
-                    // Проверяем корректность даты
-                    if (day < 1 || day > 31 || month < 1 || month > 12 || year < 1900 || year > 2024) {
-                        enqueueMessage(message->chat->id,
-                            "Ошибка: Некорректная дата. Используйте формат: /add никнейм день.месяц.год (например: /add john 15.03.1990)");
-                        return;
-                    }
-
-                    birthday_manager_.addBirthday(nickname, day, month, year);
-                    enqueueMessage(message->chat->id,
-                        "✅ День рождения пользователя " + nickname + " (" + to_string(day) + "." + to_string(month) + "." + to_string(year) + ") успешно сохранен!");
-
-                    logger_->info("Added birthday for user {} by {}: {}.{}.{}", nickname, username, day, month, year);
-                } else {
-                    enqueueMessage(message->chat->id,
-                        "Ошибка: Неверный формат команды.\n\n"
-                        "Используйте:\n"
-                        "• /add день.месяц.год - добавить свой день рождения\n"
-                        "• /add никнейм день.месяц.год - добавить день рождения другого пользователя\n\n"
-                        "Примеры:\n"
-                        "• /add 15.03.1990\n"
-                        "• /add john 25.12.1985");
+            birthdays_.get(message->chat->id).addBirthday(nickname, date->day, date->month, date->year);
+            enqueueMessage(message->chat->id,
+                "✅ День рождения пользователя " + nickname + " (" + to_string(date->day) + "." + to_string(date->month) + "." + to_string(date->year) + ") успешно сохранен!");
+
+            logger_->info("Added birthday for user {} by {}: {}.{}.{}", nickname, username, date->day, date->month, date->year);
+        } else {
+            enqueueMessage(message->chat->id,
+                "Ошибка: Неверный формат команды.\n\n"
+                "Используйте:\n"
+                "• /add день.месяц.год - добавить свой день рождения\n"
+                "• /add никнейм день.месяц.год - добавить день рождения другого пользователя\n\n"
+                "Примеры:\n"
+                "• /add 15.03.1990\n"
+                "• /add john 25.12.1985");
+        }
+    }
+
+    // Таблица команд, упорядоченная по имени. Тяжелые команды (рендеринг
+    // списка, топ рейтинга) стоят в лимитах дороже
+    using CommandHandler = void (BirthdayBot::*)(const Message::Ptr&);
+    static constexpr array<CommandRoute<CommandHandler>, 14> kCommands{{
+        {"add", &BirthdayBot::handleAdd},
+        {"dr", &BirthdayBot::handleDr, 3},
+        {"gay", &BirthdayBot::handleGay},
+        {"gaytop", &BirthdayBot::handleGayTop, 2},
+        {"grazd", &BirthdayBot::handleGrazd},
+        {"grazdtop", &BirthdayBot::handleGrazdTop, 2},
+        {"hi", &BirthdayBot::handleHi},
+        {"imgay", &BirthdayBot::handleImgay},
+        {"kek", &BirthdayBot::handleKek},
+        {"lol", &BirthdayBot::handleLol},
+        {"rand", &BirthdayBot::handleRand},
+        {"subscribe", &BirthdayBot::handleSubscribe},
+        {"tz", &BirthdayBot::handleTz},
+        {"unsubscribe", &BirthdayBot::handleUnsubscribe},
+    }};
+    static_assert(isSortedRouteTable(kCommands), "kCommands must be sorted by name without duplicates");
+
+    void setupCommands() {
+        for (const auto& command : kCommands) {
+            const string labels = "command=\"" + string(command.name) + "\"";
+            routeMetrics_.push_back(RouteMetrics{
+                &metrics_.histogram("bot_handler_seconds", "Command handler execution time", latencyBuckets(), labels),
+                &metrics_.histogram("bot_handler_queue_seconds", "Time an update waits for a handler thread",
+                                    latencyBuckets(), labels)});
+        }
+        bot_.getEvents().onAnyMessage([this](Message::Ptr message) { route(message); });
+        bot_.getEvents().onInlineQuery([this](InlineQuery::Ptr query) {
+            // answerInlineQuery - синхронный HTTP-вызов, поток приема его не ждет
+            handlers_.submit(query->from->id, [this, query]() {
+                ScopedTimer timer(inlineSeconds_);
+                try {
+                    handleInlineQuery(query);
+                } catch (const exception& e) {
+                    LOG_SAMPLED(logger_, spdlog::level::warn, kErrorLogLimit, "Inline query failed: {}", e.what());
                 }
+            });
+        });
+    }
+
+    // Инлайн-режим ("@бот jo"): дни рождения, никнейм которых начинается с
+    // запроса, из чатов, где пользователь писал боту. Ответ собирается из
+    // индекса никнеймов без блокировок и перебора всех записей
+    static constexpr size_t kInlineResults = 20;
+    static constexpr int32_t kInlineCacheSeconds = 10;
+
+    void handleInlineQuery(const InlineQuery::Ptr& query) {
+        string_view prefix = query->query;
+        while (!prefix.empty() && (prefix.front() == ' ' || prefix.front() == '@')) {
+            prefix.remove_prefix(1);
+        }
+        while (!prefix.empty() && prefix.back() == ' ') {
+            prefix.remove_suffix(1);
+        }
+
+        vector<InlineQueryResult::Ptr> results;
+        for (int64_t chatId : userChats_.chatsOf(query->from->id)) {
+            if (results.size() >= kInlineResults) {
+                break;
+            }
+            const CivilDate today = chatToday(chatId);
+            for (const auto& info : birthdays_.get(chatId).findByPrefix(prefix, kInlineResults - results.size())) {
+                const string details = renderBirthdayDetails(info, today);
+                auto content = make_shared<InputTextMessageContent>();
+                content->messageText = "🎂 " + info.nickname + " - " + details;
+                auto article = make_shared<InlineQueryResultArticle>();
+                article->id = to_string(results.size());
+                article->title = info.nickname;
+                article->description = details;
+                article->inputMessageContent = content;
+                results.push_back(article);
+            }
+        }
+        // Ответ личный: у другого пользователя другие чаты
+        bot_.getApi().answerInlineQuery(query->id, results, kInlineCacheSeconds, true);
+    }
+
+    // Маршрутизация в потоке приема: поиск команды в таблице, лимиты, затем
+    // очередь пула. Отброшенная команда не доходит до пула и хранилища
+    void route(const Message::Ptr& message) {
+        if (!message->from) {
+            return; // сообщение без автора
+        }
+        // Любое сообщение, которое видит бот, открывает пользователю данные чата в инлайн-режиме
+        userChats_.remember(message->from->id, message->chat->id);
+        const size_t index = findRoute(kCommands, commandName(message->text));
+        if (index == kCommands.size()) {
+            return; // не команда или неизвестная команда
+        }
+        const auto& command = kCommands[index];
+        const int64_t chatId = message->chat->id;
+        const int64_t userId = message->from->id;
+        const auto received = chrono::steady_clock::now();
+
+        switch (flood_.check(userId, chatId, command.cost, received)) {
+        case FloodVerdict::Allow:
+            break;
+        case FloodVerdict::Notify:
+            commandsDropped_.inc();
+            LOG_SAMPLED(logger_, spdlog::level::warn, kErrorLogLimit, "Flood limit reached by user {} in chat {} on /{}",
+                        userId, chatId, command.name);
+            enqueueMessage(chatId, "Ты для меня слишком дахуя спамишь, поэтому для тя пока команда /imgay нахуй");
+            return;
+        case FloodVerdict::Drop:
+            commandsDropped_.inc();
+            return;
+        }
+
+        handlers_.submit(chatId, [this, index, message, received]() {
+            const auto& command = kCommands[index];
+            const auto& metrics = routeMetrics_[index];
+            metrics.queueWait->observe(chrono::steady_clock::now() - received);
+            LOG_SAMPLED(logger_, spdlog::level::info, kCommandLogLimit, "Received /{} command from user: {}",
+                        command.name, message->from->username);
+            ScopedTimer timer(*metrics.latency);
+            try {
+                (this->*command.handler)(message);
+            } catch (const exception& e) {
+                logger_->error("Handler /{} failed: {}", command.name, e.what());
             }
         });
+    }
+
+    // Прием обновлений через long polling: один запрос к Telegram за раз
+    void pollUpdates() {
+        // Вебхук, оставшийся от запуска в режиме вебхука, не дает вызывать getUpdates
+        try {
+            bot_.getApi().deleteWebhook();
+        } catch (const TgException& e) {
+            logger_->warn("Failed to delete webhook: {}", e.what());
+        }
+        // Очистим накопленные до старта обновления: пропустим все старые сообщения
+        try {
+            bot_.getApi().getUpdates(std::numeric_limits<int32_t>::max(), 0, 0, {});
+            logger_->info("Skipped pending updates that arrived before startup");
+        } catch (const TgException& e) {
+            logger_->warn("Failed to skip pending updates: {}", e.what());
+        }
+
+        TgLongPoll longPoll(bot_);
+        while (true) {
+            try {
+                longPoll.start();
+            } catch (const TgException& e) {
+                logger_->error("LongPoll error: {}", e.what());
+                logger_->info("Waiting 5 seconds before retry...");
+                this_thread::sleep_for(chrono::seconds(5));
+            }
+        }
+    }
+
+    // Прием обновлений вебхуком: Telegram сам присылает POST на локальный порт
+    // (TLS завершается на прокси перед ботом). Обработчик сервера только
+    // разбирает обновление и ставит его в пул, поэтому ответ 200 уходит сразу
+    void serveWebhook(unsigned short port) {
+        const char* path_env = getenv("WEBHOOK_PATH");
+        const string path = path_env && *path_env ? path_env : "/webhook";
+        if (const char* url = getenv("WEBHOOK_URL"); url && *url) {
+            try {
+                bot_.getApi().setWebhook(url);
+                logger_->info("Webhook registered: {}", url);
+            } catch (const TgException& e) {
+                logger_->error("Failed to register webhook {}: {}", url, e.what());
+            }
+        } else {
+            logger_->warn("WEBHOOK_URL is not set; webhook must be registered separately");
+        }
+
+        // Порт занимается в конструкторе: ошибка bind завершает run()
+        TgWebhookTcpServer server(port, path, bot_.getEventHandler());
+        logger_->info("Listening for webhook updates on port {} at {}", port, path);
+        while (true) {
+            try {
+                server.start();
+            } catch (const exception& e) {
+                logger_->error("Webhook server error: {}", e.what());
+            }
+        }
+    }
 
-        // // Обработка неизвестных команд
-        // bot_.getEvents().onAnyMessage([this](Message::Ptr message) {
-        //     if (message->text.empty()) return;
+    static string apiUrl() {
+        const char* env = getenv("TELEGRAM_API_URL");
+        return env && *env ? env : "https://api.telegram.org";
+    }
+
+    static unique_ptr<HttpClient> makeHttpClient() {
+#ifdef HAVE_CURL
+        if (const char* env = getenv("TELEGRAM_API_URL"); env && *env) {
+            return make_unique<CurlHttpClient>();
+        }
+#endif
+        return make_unique<BoostHttpOnlySslClient>();
+    }
 
-        //     if (message->text[0] == '/') {
-        //         logger_->warn("Unknown command from user {}: {}", message->from->username, message->text);
-        //         enqueueMessage(message->chat->id,
-        //             "❓ Неизвестная команда. Доступные команды:\n\n"
-        //             "• /dr [N] - показать дни рождения в ближайшие N дней (по умолчанию 365)\n"
-        //             "• /add день.месяц.год - добавить свой день рождения\n"
-        //             "• /add никнейм день.месяц.год - добавить день рождения другого пользователя");
-        //     }
-        // });
+    // Постоянных соединений для sendMessage (по умолчанию 4)
+    static size_t sendConnections() {
+        const char* env = getenv("SEND_CONNECTIONS");
+        auto count = env ? parseInt(env) : nullopt;
+        return count && *count > 0 && *count <= 32 ? static_cast<size_t>(*count) : 4;
+    }
+
+    static optional<unsigned short> webhookPort() {
+        const char* env = getenv("WEBHOOK_PORT");
+        if (!env || !*env) {
+            return nullopt;
+        }
+        auto port = parseInt(env);
+        if (!port || *port == 0 || *port > 65535) {
+            return nullopt;
+        }
+        return static_cast<unsigned short>(*port);
     }
 
 public:
-    BirthdayBot(const string& token) : bot_(token), birthday_manager_("birthdays.json") {
+    BirthdayBot(const string& token)
+        : bot_(token, *httpClient_, apiUrl()), pipeline_(token, apiUrl(), sendConnections()) {
         setupLogger();
+        migrateLegacyData();
+        restoreOutbox();
+        setupMetrics();
         setupCommands();
     }
 
     void run() {
         logger_->info("Starting Birthday Bot...");
+        if (getenv("TELEGRAM_API_URL")) {
+            logger_->warn("Using Bot API at {}", apiUrl());
+        }
+        const auto port = webhookPort();
+        if (getenv("WEBHOOK_PORT") && !port) {
+            logger_->error("WEBHOOK_PORT must be a port number between 1 and 65535");
+            return;
+        }
 
         try {
-            logger_->info("Bot username: {}", bot_.getApi().getMe()->username);
-            logger_->info("Bot started successfully");
-            // Очистим накопленные до старта обновления: пропустим все старые сообщения
             try {
-                bot_.getApi().getUpdates(std::numeric_limits<int32_t>::max(), 0, 0, {});
-                logger_->info("Skipped pending updates that arrived before startup");
+                logger_->info("Bot username: {}", bot_.getApi().getMe()->username);
             } catch (const TgException& e) {
-                logger_->warn("Failed to skip pending updates: {}", e.what());
+                // Без связи с Telegram вебхук все равно принимает обновления (например, записанные)
+                if (!port) {
+                    throw;
+                }
+                logger_->warn("getMe failed: {}", e.what());
             }
+            logger_->info("Bot started successfully");
+            outbox_.start();
             startSenderWorker();
+            metricsWriter_.start();
+            announcer_.start();
+            dataWatcher_.start();
 
-            TgLongPoll longPoll(bot_);
-            while (true) {
-                try {
-                    longPoll.start();
-                } catch (const TgException& e) {
-                    logger_->error("LongPoll error: {}", e.what());
-                    logger_->info("Waiting 5 seconds before retry...");
-                    this_thread::sleep_for(chrono::seconds(5));
-                }
+            if (port) {
+                serveWebhook(*port);
+            } else {
+                pollUpdates();
             }
         } catch (const TgException& e) {
             logger_->error("Telegram error: {}", e.what());
         } catch (const exception& e) {
             logger_->error("General error: {}", e.what());
         }
+        dataWatcher_.stop();
+        announcer_.stop();
+        handlers_.stop();
         stopSenderWorker();
+        outbox_.stop();
+        metricsWriter_.stop();
     }
 };
 
@@ -473,8 +888,12 @@ int main() {
         return 1;
     }
 
-    BirthdayBot bot(token);
-    bot.run();
+    {
+        BirthdayBot bot(token);
+        bot.run();
+    }
+    // Дописать записи, оставшиеся в очереди асинхронного логгера
+    spdlog::shutdown();
 
     return 0;
 }
@@ -0,0 +1,193 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::string formatValue(double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    std::ostringstream out;
+    out.precision(12);
+    out << value;
+    return out.str();
+}
+
+std::string joinLabels(const std::string& labels, const std::string& extra) {
+    if (labels.empty() && extra.empty()) return "";
+    if (labels.empty()) return "{" + extra + "}";
+    if (extra.empty()) return "{" + labels + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+} // namespace
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)),
+      counts_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+    std::sort(bounds_.begin(), bounds_.end());
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    size_t bucket = 0;
+    while (bucket < bounds_.size() && value > bounds_[bucket]) {
+        ++bucket;
+    }
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    if (value > 0) {
+        sum_.fetch_add(static_cast<uint64_t>(std::llround(value * kSumScale)), std::memory_order_relaxed);
+    }
+}
+
+double Histogram::sum() const {
+    return static_cast<double>(sum_.load(std::memory_order_relaxed)) / kSumScale;
+}
+
+std::vector<double> latencyBuckets() {
+    return {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+}
+
+std::vector<double> retryAfterBuckets() {
+    return {1, 2, 5, 10, 30, 60, 300, 1800, 3600};
+}
+
+std::vector<double> bytesBuckets() {
+    return {256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216};
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Series& MetricsRegistry::series(const std::string& name, const std::string& help,
+                                                 Type type, const std::string& labels) {
+    auto family = std::find_if(families_.begin(), families_.end(),
+        [&name](const Family& f) { return f.name == name; });
+    if (family == families_.end()) {
+        families_.push_back(Family{name, help, type, {}});
+        family = families_.end() - 1;
+    }
+    for (auto& existing : family->series) {
+        if (existing.labels == labels) {
+            return existing;
+        }
+    }
+    family->series.push_back(Series{labels, nullptr, nullptr, nullptr, nullptr});
+    return family->series.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& s = series(name, help, Type::Counter, labels);
+    if (!s.counter) s.counter = std::make_unique<Counter>();
+    return *s.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& s = series(name, help, Type::Gauge, labels);
+    if (!s.gauge) s.gauge = std::make_unique<Gauge>();
+    return *s.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      std::vector<double> bounds, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& s = series(name, help, Type::Histogram, labels);
+    if (!s.histogram) s.histogram = std::make_unique<Histogram>(std::move(bounds));
+    return *s.histogram;
+}
+
+void MetricsRegistry::gaugeCallback(const std::string& name, const std::string& help,
+                                    std::function<double()> callback, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    series(name, help, Type::Gauge, labels).callback = std::move(callback);
+}
+
+std::string MetricsRegistry::render() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    for (const auto& family : families_) {
+        const char* type = family.type == Type::Counter ? "counter"
+            : family.type == Type::Gauge ? "gauge" : "histogram";
+        out += "# HELP " + family.name + " " + family.help + "\n";
+        out += "# TYPE " + family.name + " " + type + "\n";
+
+        for (const auto& s : family.series) {
+            if (s.counter) {
+                out += family.name + joinLabels(s.labels, "") + " " + std::to_string(s.counter->value()) + "\n";
+            } else if (s.gauge) {
+                out += family.name + joinLabels(s.labels, "") + " " + std::to_string(s.gauge->value()) + "\n";
+            } else if (s.callback) {
+                out += family.name + joinLabels(s.labels, "") + " " + formatValue(s.callback()) + "\n";
+            } else if (s.histogram) {
+                const auto& h = *s.histogram;
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i <= h.bounds().size(); ++i) {
+                    cumulative += h.bucketCount(i);
+                    const double le = i < h.bounds().size() ? h.bounds()[i] : INFINITY;
+                    out += family.name + "_bucket" + joinLabels(s.labels, "le=\"" + formatValue(le) + "\"")
+                        + " " + std::to_string(cumulative) + "\n";
+                }
+                out += family.name + "_sum" + joinLabels(s.labels, "") + " " + formatValue(h.sum()) + "\n";
+                out += family.name + "_count" + joinLabels(s.labels, "") + " " + std::to_string(h.count()) + "\n";
+            }
+        }
+    }
+    return out;
+}
+
+MetricsFileWriter::MetricsFileWriter(std::string path, std::chrono::seconds interval)
+    : path_(std::move(path)), interval_(interval) {}
+
+MetricsFileWriter::~MetricsFileWriter() {
+    stop();
+}
+
+void MetricsFileWriter::start() {
+    if (path_.empty() || thread_.joinable()) {
+        return;
+    }
+    stop_ = false;
+    thread_ = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval_, [this] { return stop_; })) {
+            writeOnce();
+        }
+    });
+}
+
+void MetricsFileWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+        writeOnce();
+    }
+}
+
+void MetricsFileWriter::writeOnce() {
+    const std::string tmp_path = path_ + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write metrics to " << tmp_path << std::endl;
+            return;
+        }
+        file << MetricsRegistry::instance().render();
+    }
+    std::rename(tmp_path.c_str(), path_.c_str());
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Метрики бота в формате Prometheus.
+//
+// Запись значения - только relaxed-атомики без блокировок, поэтому метрики
+// можно держать включенными постоянно. Регистрация (получение ссылки на
+// метрику) берет мьютекс и делается один раз при настройке; горячий путь
+// работает с сохраненной ссылкой.
+
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Гистограмма с фиксированными границами корзин (le)
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    template <typename Rep, typename Period>
+    void observe(std::chrono::duration<Rep, Period> elapsed) {
+        observe(std::chrono::duration<double>(elapsed).count());
+    }
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    // Количество наблюдений в корзине i (последняя - +Inf), не накопительно
+    uint64_t bucketCount(size_t i) const { return counts_[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const;
+
+private:
+    // Сумма хранится в миллионных долях единицы: atomic<double> не умеет fetch_add в C++17
+    static constexpr double kSumScale = 1e6;
+
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// Стандартные наборы границ
+std::vector<double> latencyBuckets();
+std::vector<double> retryAfterBuckets();
+std::vector<double> bytesBuckets();
+
+// Замер времени области видимости
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram_.observe(std::chrono::steady_clock::now() - start_); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    // labels - готовая строка вида command="dr" (без фигурных скобок) или пустая.
+    // Повторный вызов с тем же именем и метками возвращает ту же метрику
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help,
+                         std::vector<double> bounds, const std::string& labels = "");
+
+    // Gauge, значение которого вычисляется при выгрузке (глубина очереди и т.п.)
+    void gaugeCallback(const std::string& name, const std::string& help, std::function<double()> callback,
+                       const std::string& labels = "");
+
+    // Текстовый формат Prometheus
+    std::string render() const;
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> callback;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        Type type;
+        std::vector<Series> series;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Family> families_;
+
+    Series& series(const std::string& name, const std::string& help, Type type, const std::string& labels);
+};
+
+// Периодически и атомарно (temp + rename) переписывает файл с метриками,
+// например для textfile-коллектора node_exporter
+class MetricsFileWriter {
+public:
+    MetricsFileWriter(std::string path, std::chrono::seconds interval);
+    ~MetricsFileWriter();
+
+    void start();
+    void stop();
+
+private:
+    std::string path_;
+    std::chrono::seconds interval_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    void writeOnce();
+};
@@ -0,0 +1,287 @@
+#include "outbound_scheduler.h"
+#include <algorithm>
+#include <optional>
+
+size_t utf16Length(std::string_view text) {
+    size_t length = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) == 0x80) {
+            continue; // продолжение символа
+        }
+        length += c >= 0xF0 ? 2 : 1; // 4-байтовые символы - суррогатная пара
+    }
+    return length;
+}
+
+std::vector<std::string> splitMessage(std::string_view text, size_t limit) {
+    std::vector<std::string> parts;
+    while (utf16Length(text) > limit) {
+        // Самый длинный префикс в пределах limit и последний перевод строки в нем
+        size_t units = 0;
+        size_t cut = 0;
+        size_t newline = std::string_view::npos;
+        for (size_t i = 0; i < text.size(); ++i) {
+            const unsigned char c = static_cast<unsigned char>(text[i]);
+            if ((c & 0xC0) == 0x80) {
+                continue;
+            }
+            units += c >= 0xF0 ? 2 : 1;
+            if (units > limit) {
+                break;
+            }
+            cut = i;
+            if (c == '\n') {
+                newline = i;
+            }
+        }
+        // cut - начало последнего поместившегося символа; берем его целиком
+        size_t end = cut + 1;
+        while (end < text.size() && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+            ++end;
+        }
+        if (newline != std::string_view::npos && newline > 0) {
+            parts.emplace_back(text.substr(0, newline));
+            text.remove_prefix(newline + 1);
+        } else {
+            parts.emplace_back(text.substr(0, end));
+            text.remove_prefix(end);
+        }
+    }
+    if (!text.empty() || parts.empty()) {
+        parts.emplace_back(text);
+    }
+    return parts;
+}
+
+void OutboundScheduler::enqueue(int64_t chatId, std::string text, MessagePriority priority, uint64_t outboxId) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return;
+        }
+
+        const int lane = static_cast<int>(priority);
+        auto& chat = chats_[chatId];
+        const auto now = Clock::now();
+        if (utf16Length(text) > kMaxMessageLength) {
+            for (auto& part : splitMessage(text)) {
+                chat.lanes[lane].push_back(OutboundMessage{chatId, std::move(part), priority, now});
+                ++pending_;
+            }
+        } else {
+            chat.lanes[lane].push_back(OutboundMessage{chatId, std::move(text), priority, now});
+            ++pending_;
+        }
+        if (outboxId != 0) {
+            chat.lanes[lane].back().ids.push_back(outboxId);
+        }
+
+        if (chat.inFlight || chat.waiting) {
+            // Чат сам вернется в планирование после отправки или по таймеру
+            return;
+        }
+        if (chat.readyLane != kNotReady) {
+            // Интерактивное сообщение поднимает уже готовый чат в приоритетный список;
+            // старая запись в списке массовых рассылок будет пропущена как устаревшая
+            if (lane < chat.readyLane) {
+                chat.readyLane = lane;
+                ready_[lane].push_back(chatId);
+            }
+            return;
+        }
+        schedule(chatId, chat, Clock::now());
+    }
+    cv_.notify_one();
+}
+
+bool OutboundScheduler::next(OutboundMessage& message) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_) {
+        const auto now = Clock::now();
+        promoteExpired(now);
+        if (now >= nextEviction_) {
+            limiter_.evictIdle(now);
+            nextEviction_ = now + kEvictionInterval;
+        }
+
+        std::optional<Clock::time_point> wake;
+        if (!timers_.empty()) {
+            wake = timers_.top().at;
+        }
+        if (hasReady()) {
+            // Готовые чаты ждут только общего токена
+            const auto global = limiter_.globalReadyAt(now);
+            if (global <= now) {
+                if (popReady(message, now)) {
+                    return true;
+                }
+            } else if (!wake || global < *wake) {
+                wake = global;
+            }
+        }
+        if (wake) {
+            cv_.wait_until(lock, *wake);
+        } else {
+            cv_.wait(lock);
+        }
+    }
+    return false;
+}
+
+void OutboundScheduler::complete(int64_t chatId) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        limiter_.onSuccess(chatId);
+        auto it = chats_.find(chatId);
+        if (it == chats_.end()) {
+            return;
+        }
+        auto& chat = it->second;
+        chat.inFlight = false;
+        if (chat.empty()) {
+            // Лимиты чата хранит limiter_; устаревшие записи в ready_ и timers_ пропускаются
+            chats_.erase(it);
+            return;
+        }
+        schedule(chatId, chat, Clock::now());
+    }
+    cv_.notify_one();
+}
+
+void OutboundScheduler::rateLimited(OutboundMessage message, std::chrono::seconds retryAfter) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return;
+        }
+        const auto now = Clock::now();
+        const int64_t chatId = message.chatId;
+        limiter_.onRateLimited(chatId, retryAfter, now);
+        auto& chat = chats_[chatId];
+        chat.inFlight = false;
+        chat.lanes[static_cast<int>(message.priority)].push_front(std::move(message));
+        ++pending_;
+        schedule(chatId, chat, now);
+    }
+    cv_.notify_one();
+}
+
+void OutboundScheduler::retry(OutboundMessage message, Clock::time_point retryAt) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return;
+        }
+        const int64_t chatId = message.chatId;
+        auto& chat = chats_[chatId];
+        chat.inFlight = false;
+        chat.nextAllowed = retryAt;
+        chat.lanes[static_cast<int>(message.priority)].push_front(std::move(message));
+        ++pending_;
+        schedule(chatId, chat, Clock::now());
+    }
+    cv_.notify_one();
+}
+
+void OutboundScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cv_.notify_all();
+}
+
+size_t OutboundScheduler::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+size_t OutboundScheduler::limitedChats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limiter_.chats();
+}
+
+size_t OutboundScheduler::throttledChats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limiter_.throttledChats();
+}
+
+OutboundScheduler::Clock::duration OutboundScheduler::oldestAge() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = Clock::now();
+    auto oldest = now;
+    for (const auto& [chatId, chat] : chats_) {
+        for (const auto& lane : chat.lanes) {
+            if (!lane.empty() && lane.front().enqueuedAt < oldest) {
+                oldest = lane.front().enqueuedAt;
+            }
+        }
+    }
+    return now - oldest;
+}
+
+void OutboundScheduler::schedule(int64_t chatId, ChatQueue& chat, Clock::time_point now) {
+    const auto readyAt = std::max(chat.nextAllowed, limiter_.chatReadyAt(chatId, now));
+    if (readyAt <= now) {
+        chat.readyLane = chat.topLane();
+        ready_[chat.readyLane].push_back(chatId);
+    } else {
+        chat.waiting = true;
+        timers_.push(Timer{readyAt, chatId});
+    }
+}
+
+void OutboundScheduler::promoteExpired(Clock::time_point now) {
+    while (!timers_.empty() && timers_.top().at <= now) {
+        const int64_t chatId = timers_.top().chatId;
+        timers_.pop();
+        auto it = chats_.find(chatId);
+        if (it == chats_.end() || !it->second.waiting) {
+            continue;
+        }
+        it->second.waiting = false;
+        schedule(chatId, it->second, now);
+    }
+}
+
+bool OutboundScheduler::popReady(OutboundMessage& message, Clock::time_point now) {
+    for (int lane = 0; lane < kLanes; ++lane) {
+        while (!ready_[lane].empty()) {
+            const int64_t chatId = ready_[lane].front();
+            ready_[lane].pop_front();
+            auto it = chats_.find(chatId);
+            if (it == chats_.end() || it->second.readyLane != lane) {
+                continue; // устаревшая запись: чат перешел в другой список
+            }
+
+            auto& chat = it->second;
+            auto& queue = chat.lanes[chat.topLane()];
+            chat.readyLane = kNotReady;
+            chat.inFlight = true;
+            limiter_.acquire(chatId, now);
+            message = std::move(queue.front());
+            queue.pop_front();
+            --pending_;
+
+            // Доклеиваем следующие сообщения полосы по порядку, пока влезают в лимит
+            size_t length = utf16Length(message.text);
+            while (!queue.empty()) {
+                const size_t extra = kSeparator.size() + utf16Length(queue.front().text);
+                if (length + extra > kMaxMessageLength) {
+                    break;
+                }
+                message.text.append(kSeparator);
+                message.text.append(queue.front().text);
+                message.parts += queue.front().parts;
+                const auto& ids = queue.front().ids;
+                message.ids.insert(message.ids.end(), ids.begin(), ids.end());
+                message.attempts = std::max(message.attempts, queue.front().attempts);
+                length += extra;
+                queue.pop_front();
+                --pending_;
+            }
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "rate_limiter.h"
+
+// Приоритет исходящего сообщения: ответы на команды идут раньше массовых рассылок
+enum class MessagePriority {
+    Interactive = 0,
+    Bulk = 1,
+};
+
+struct OutboundMessage {
+    int64_t chatId = 0;
+    std::string text;
+    MessagePriority priority = MessagePriority::Interactive;
+    std::chrono::steady_clock::time_point enqueuedAt{};
+    size_t parts = 1; // сколько поставленных в очередь сообщений склеено в text
+    std::vector<uint64_t> ids{}; // номера в OutboxLog, которые подтверждает доставка
+    int attempts = 0;            // неудачных попыток отправки (кроме 429)
+};
+
+// Предел длины сообщения Telegram. Считается в кодовых единицах UTF-16:
+// эмодзи вне BMP занимают две единицы
+constexpr size_t kMaxMessageLength = 4096;
+
+// Длина текста UTF-8 в кодовых единицах UTF-16
+size_t utf16Length(std::string_view text);
+
+// Разбить текст на части не длиннее limit единиц UTF-16: по границам строк,
+// а строку длиннее limit - по границам символов
+std::vector<std::string> splitMessage(std::string_view text, size_t limit = kMaxMessageLength);
+
+// Планировщик исходящих сообщений.
+//
+// У каждого чата своя FIFO-очередь на каждый приоритет. Когда чату можно
+// писать, решает RateLimiter (общее ведро токенов и ведро на чат). Чаты, которым
+// еще рано писать, лежат в мин-куче по времени готовности, готовые - в списках
+// по приоритетам; сообщение выдается, только когда есть и общий токен. Воркер
+// спит только до ближайшего готового чата, поэтому приторможенный чат не
+// задерживает остальные. Пока сообщение чата отправляется, чат не выдается
+// повторно - порядок сообщений внутри чата сохраняется. Чат без сообщений
+// удаляется из таблицы, а его лимиты - из RateLimiter, когда вернутся к исходным.
+//
+// Сообщения, накопившиеся в одной полосе чата к моменту отправки, выдаются
+// одним сообщением (через пустую строку), пока склейка не длиннее
+// kMaxMessageLength: серия ответов в одном чате уходит одним вызовом API, а не
+// одним вызовом и паузой на каждый ответ. Слишком длинный текст разбивается
+// на части еще при постановке в очередь.
+class OutboundScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    OutboundScheduler() = default;
+    explicit OutboundScheduler(const RateLimiter::Config& limits) : limiter_(limits) {}
+
+    // outboxId - номер сообщения в OutboxLog (0 - не записано). Длинный текст
+    // делится на части, номер достается последней: подтверждение означает, что
+    // доставлены все части
+    void enqueue(int64_t chatId, std::string text, MessagePriority priority, uint64_t outboxId = 0);
+
+    // Дождаться следующего готового сообщения (возможно, склеенного из
+    // нескольких). false - планировщик остановлен
+    bool next(OutboundMessage& message);
+
+    // Сообщение отправлено
+    void complete(int64_t chatId);
+
+    // Ответ 429: вернуть сообщение в голову очереди чата, не писать в чат
+    // retryAfter и снизить его темп
+    void rateLimited(OutboundMessage message, std::chrono::seconds retryAfter);
+
+    // Прочая ошибка: вернуть сообщение в голову очереди чата и повторить не раньше retryAt
+    void retry(OutboundMessage message, Clock::time_point retryAt);
+
+    void stop();
+
+    // Количество сообщений, ожидающих отправки
+    size_t size() const;
+
+    // Возраст самого старого ожидающего сообщения (ноль, если очередь пуста).
+    // Обходит все чаты - для выгрузки метрик, не для горячего пути
+    Clock::duration oldestAge() const;
+
+    // Чатов с состоянием лимитов и из них - с темпом, сниженным после 429
+    size_t limitedChats() const;
+    size_t throttledChats() const;
+
+private:
+    static constexpr int kLanes = 2;
+    static constexpr int kNotReady = -1;
+    static constexpr std::string_view kSeparator = "\n\n";
+    static constexpr std::chrono::minutes kEvictionInterval{1};
+
+    struct ChatQueue {
+        std::deque<OutboundMessage> lanes[kLanes];
+        Clock::time_point nextAllowed{}; // пауза после ошибки отправки (кроме 429)
+        int readyLane = kNotReady; // в каком списке готовых стоит чат
+        bool waiting = false;      // чат в куче таймеров
+        bool inFlight = false;     // сообщение чата сейчас отправляется
+
+        bool empty() const { return lanes[0].empty() && lanes[1].empty(); }
+        int topLane() const { return lanes[0].empty() ? 1 : 0; }
+    };
+
+    struct Timer {
+        Clock::time_point at;
+        int64_t chatId;
+        bool operator>(const Timer& other) const { return at > other.at; }
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<int64_t, ChatQueue> chats_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    std::deque<int64_t> ready_[kLanes];
+    size_t pending_ = 0;
+    bool stopped_ = false;
+    RateLimiter limiter_;
+    Clock::time_point nextEviction_{};
+
+    void schedule(int64_t chatId, ChatQueue& chat, Clock::time_point now);
+    void promoteExpired(Clock::time_point now);
+    bool hasReady() const { return !ready_[0].empty() || !ready_[1].empty(); }
+    bool popReady(OutboundMessage& message, Clock::time_point now);
+};
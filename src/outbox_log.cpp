@@ -0,0 +1,322 @@
+#include "outbox_log.h"
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+bool syncFile(int fd) {
+#ifdef __APPLE__
+    return ::fsync(fd) == 0;
+#else
+    return ::fdatasync(fd) == 0;
+#endif
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+int openAppend(const std::string& path) {
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+// Дописать данные и дождаться диска. При ошибке файл обрезается до прежнего
+// размера, чтобы следующая запись не склеилась с недописанной строкой
+bool appendDurably(int fd, const std::string& data, const std::string& path) {
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        std::cerr << "Error: Cannot append to " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (writeAll(fd, data.data(), data.size()) && syncFile(fd)) {
+        return true;
+    }
+    std::cerr << "Error: Cannot append to " << path << ": " << std::strerror(errno) << std::endl;
+    if (::ftruncate(fd, st.st_size) != 0) {
+        std::cerr << "Error: Cannot truncate " << path << ": " << std::strerror(errno) << std::endl;
+    }
+    return false;
+}
+
+// Номер сегмента из имени "<номер>.log"
+std::optional<uint64_t> segmentNumber(const std::string& name) {
+    constexpr std::string_view suffix = ".log";
+    if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return std::nullopt;
+    }
+    uint64_t number = 0;
+    const char* end = name.data() + name.size() - suffix.size();
+    auto [ptr, ec] = std::from_chars(name.data(), end, number);
+    if (ec != std::errc() || ptr != end) {
+        return std::nullopt;
+    }
+    return number;
+}
+
+} // namespace
+
+OutboxLog::OutboxLog(std::string dir)
+    : dir_(std::move(dir)), dead_path_(dir_ + "/dead.log") {}
+
+OutboxLog::~OutboxLog() {
+    stop();
+}
+
+std::string OutboxLog::segmentPath(uint64_t segment) const {
+    return dir_ + "/" + std::to_string(segment) + ".log";
+}
+
+std::vector<OutboxLog::Record> OutboxLog::recover() {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) {
+        std::cerr << "Error: Cannot create outbox directory " << dir_ << ": " << ec.message() << std::endl;
+    }
+
+    std::vector<uint64_t> segments;
+    for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+        if (auto number = segmentNumber(entry.path().filename().string())) {
+            segments.push_back(*number);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+
+    // Номер сообщения растет с постановкой, поэтому map сразу дает порядок отправки
+    std::map<uint64_t, Record> records;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint64_t segment : segments) {
+        live_.emplace(segment, 0);
+        std::ifstream in(segmentPath(segment));
+        std::string line;
+        while (std::getline(in, line)) {
+            auto value = nlohmann::json::parse(line, nullptr, false);
+            if (!value.is_object()) {
+                // Строка, оборванная падением посреди записи
+                std::cerr << "Warning: Skipping damaged outbox record in " << segmentPath(segment) << std::endl;
+                continue;
+            }
+            if (auto ack = value.find("ack"); ack != value.end() && ack->is_number_unsigned()) {
+                auto it = segment_of_.find(ack->get<uint64_t>());
+                if (it != segment_of_.end()) {
+                    --live_[it->second];
+                    records.erase(it->first);
+                    segment_of_.erase(it);
+                }
+                continue;
+            }
+            Record record;
+            record.id = value.value("id", uint64_t{0});
+            record.chatId = value.value("chat", int64_t{0});
+            record.priority = value.value("prio", 0) == 0 ? MessagePriority::Interactive : MessagePriority::Bulk;
+            record.text = value.value("text", std::string());
+            if (record.id == 0 || record.text.empty()) {
+                continue;
+            }
+            next_id_ = std::max(next_id_, record.id + 1);
+            if (segment_of_.emplace(record.id, segment).second) {
+                ++live_[segment];
+                records.emplace(record.id, std::move(record));
+            }
+        }
+    }
+
+    // В старые сегменты больше не пишем: их хвост мог оборваться
+    active_ = segments.empty() ? 1 : segments.back() + 1;
+    active_bytes_ = 0;
+    live_.emplace(active_, 0);
+
+    std::vector<Record> result;
+    result.reserve(records.size());
+    for (auto& [id, record] : records) {
+        result.push_back(std::move(record));
+    }
+    return result;
+}
+
+void OutboxLog::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    stop_ = false;
+    thread_ = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            // Строки, пришедшие за окно, уходят на диск одной пачкой
+            cv_.wait_for(lock, kFlushInterval, [this] { return stop_; });
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    });
+}
+
+void OutboxLog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    flush();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!chunks_.empty() || !dead_.empty()) {
+        std::cerr << "Error: Unsaved outbox records are lost; their messages may be resent or missing after restart"
+                  << std::endl;
+    }
+}
+
+uint64_t OutboxLog::append(int64_t chatId, std::string_view text, MessagePriority priority) {
+    nlohmann::json value{
+        {"chat", chatId},
+        {"prio", static_cast<int>(priority)},
+        {"text", text},
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t id = next_id_++;
+    value["id"] = id;
+    // Сообщение числится за сегментом, куда попадет его строка
+    if (active_bytes_ >= kSegmentBytes) {
+        ++active_;
+        active_bytes_ = 0;
+        live_.emplace(active_, 0);
+    }
+    segment_of_.emplace(id, active_);
+    ++live_[active_];
+    appendLine(value.dump() + '\n');
+    return id;
+}
+
+void OutboxLog::ack(const std::vector<uint64_t>& ids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint64_t id : ids) {
+        acknowledge(id);
+    }
+}
+
+void OutboxLog::deadLetter(const OutboundMessage& message, std::string_view reason) {
+    nlohmann::json value{
+        {"ids", message.ids},
+        {"chat", message.chatId},
+        {"attempts", message.attempts},
+        {"error", reason},
+        {"text", message.text},
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    dead_ += value.dump();
+    dead_ += '\n';
+    for (uint64_t id : message.ids) {
+        acknowledge(id);
+    }
+}
+
+size_t OutboxLog::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segment_of_.size();
+}
+
+void OutboxLog::appendLine(const std::string& line) {
+    if (chunks_.empty() || chunks_.back().segment != active_) {
+        chunks_.push_back(Chunk{active_, std::string()});
+    }
+    chunks_.back().data += line;
+    active_bytes_ += line.size();
+}
+
+void OutboxLog::acknowledge(uint64_t id) {
+    auto it = segment_of_.find(id);
+    if (it == segment_of_.end()) {
+        return; // уже подтверждено
+    }
+    --live_[it->second];
+    segment_of_.erase(it);
+    appendLine("{\"ack\":" + std::to_string(id) + "}\n");
+}
+
+void OutboxLog::flush() {
+    std::vector<Chunk> chunks;
+    std::string dead;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunks.swap(chunks_);
+        dead.swap(dead_);
+    }
+
+    // Пишем по порядку до первой ошибки: строки сегмента не должны
+    // переставляться, поэтому после сбоя остаток пачки ждет следующего прохода
+    size_t written = 0;
+    for (; written < chunks.size(); ++written) {
+        const Chunk& chunk = chunks[written];
+        if (fd_ < 0 || fd_segment_ != chunk.segment) {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+            fd_ = openAppend(segmentPath(chunk.segment));
+            fd_segment_ = chunk.segment;
+        }
+        if (!appendDurably(fd_, chunk.data, segmentPath(chunk.segment))) {
+            break;
+        }
+    }
+    bool dead_written = true;
+    if (!dead.empty()) {
+        int fd = openAppend(dead_path_);
+        dead_written = appendDurably(fd, dead, dead_path_);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // Удаляем только префикс полностью подтвержденных сегментов, в которые уже
+    // ничего не допишется: подтверждения лежат в более поздних сегментах
+    std::vector<uint64_t> obsolete;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Незаписанное возвращается в начало очереди и повторяется на следующем
+        // проходе; сегменты начиная с первого из них не удаляются
+        if (written < chunks.size()) {
+            chunks_.insert(chunks_.begin(), std::make_move_iterator(chunks.begin() + written),
+                           std::make_move_iterator(chunks.end()));
+        }
+        if (!dead_written) {
+            dead_.insert(0, dead);
+        }
+        uint64_t limit = chunks_.empty() ? active_ : std::min(active_, chunks_.front().segment);
+        while (!live_.empty() && live_.begin()->first < limit && live_.begin()->second == 0) {
+            obsolete.push_back(live_.begin()->first);
+            live_.erase(live_.begin());
+        }
+    }
+    for (uint64_t segment : obsolete) {
+        if (fd_ >= 0 && fd_segment_ == segment) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        ::unlink(segmentPath(segment).c_str());
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "outbound_scheduler.h"
+
+// Журнал исходящих сообщений на диске: очередь отправки переживает перезапуск.
+//
+// Каталог dir содержит сегменты <номер>.log - строки JSON, только дописываемые:
+// {"id":..,"chat":..,"prio":..,"text":..} при постановке в очередь и {"ack":id},
+// когда сообщение доставлено или ушло в dead.log. append и ack только кладут
+// строку в буфер под мьютексом; фоновый поток раз в kFlushInterval пишет
+// накопленное и делает один fdatasync на пачку (group commit); пачка, которую
+// не удалось записать, отрезается от файла и повторяется на следующем
+// проходе. Сегмент закрывается после kSegmentBytes, а удаляется, когда все его сообщения
+// подтверждены и все более старые сегменты уже удалены - подтверждения из
+// следующих сегментов не теряются раньше самих сообщений.
+//
+// Гарантия - "хотя бы один раз": после падения повторяются сообщения без
+// подтверждения на диске, в том числе уже доставленные перед падением, а
+// поставленные в последние kFlushInterval могут пропасть.
+class OutboxLog {
+public:
+    struct Record {
+        uint64_t id = 0;
+        int64_t chatId = 0;
+        MessagePriority priority = MessagePriority::Interactive;
+        std::string text;
+    };
+
+    explicit OutboxLog(std::string dir = "outbox");
+    ~OutboxLog();
+
+    OutboxLog(const OutboxLog&) = delete;
+    OutboxLog& operator=(const OutboxLog&) = delete;
+
+    // Прочитать сегменты и вернуть неподтвержденные сообщения по порядку
+    // постановки. Вызывается один раз до первого append; новые записи идут в
+    // новый сегмент, недописанная строка в конце старого пропускается
+    std::vector<Record> recover();
+
+    void start();
+    // Сбросить буфер на диск и остановить фоновый поток
+    void stop();
+
+    // Записать сообщение, вернуть его номер. Не ждет диска
+    uint64_t append(int64_t chatId, std::string_view text, MessagePriority priority);
+
+    // Сообщения доставлены
+    void ack(const std::vector<uint64_t>& ids);
+
+    // Сообщение не доставить: записать в dead.log с причиной и подтвердить
+    void deadLetter(const OutboundMessage& message, std::string_view reason);
+
+    // Неподтвержденных сообщений
+    size_t pending() const;
+
+private:
+    static constexpr std::chrono::milliseconds kFlushInterval{10};
+    static constexpr size_t kSegmentBytes = 1024 * 1024;
+
+    // Строки, ожидающие записи в сегмент
+    struct Chunk {
+        uint64_t segment;
+        std::string data;
+    };
+
+    std::string dir_;
+    std::string dead_path_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Chunk> chunks_;
+    std::string dead_;
+    uint64_t next_id_ = 1;
+    uint64_t active_ = 1;        // сегмент, в который дописываются строки
+    size_t active_bytes_ = 0;
+    std::map<uint64_t, size_t> live_;                 // сегмент -> неподтвержденных сообщений
+    std::unordered_map<uint64_t, uint64_t> segment_of_; // сообщение -> сегмент
+    bool stop_ = false;
+    std::thread thread_;
+
+    // Используются только фоновым потоком (и stop после его остановки)
+    int fd_ = -1;
+    uint64_t fd_segment_ = 0;
+
+    void appendLine(const std::string& line);
+    void acknowledge(uint64_t id);
+    void flush();
+    std::string segmentPath(uint64_t segment) const;
+};
@@ -0,0 +1,14 @@
+#include "ranking_index.h"
+#include <algorithm>
+
+std::vector<RankingIndex::Entry> RankingIndex::slice(size_t offset, size_t count) const {
+    std::vector<Entry> result;
+    if (offset >= tree_.size()) {
+        return result;
+    }
+    result.reserve(std::min(count, tree_.size() - offset));
+    for (auto it = tree_.find_by_order(offset); it != tree_.end() && result.size() < count; ++it) {
+        result.emplace_back(it->row, it->score);
+    }
+    return result;
+}
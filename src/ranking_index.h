@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include "record_store.h"
+
+// Рейтинг строк RecordStore по одной оценке.
+//
+// Дерево порядковых статистик (GNU pb_ds) хранит пары (оценка, строка) по
+// убыванию оценки, при равенстве - по никнейму строки. Изменение оценки, место
+// пользователя и начало страницы рейтинга - O(log n), без полной сортировки на
+// каждый запрос. Сами оценки лежат в колонках хранилища: вызывающий передает
+// старую оценку при изменении, а пока строка в дереве, ее никнейм не меняется.
+class RankingIndex {
+public:
+    using Entry = std::pair<uint32_t, int32_t>; // строка, оценка
+
+    explicit RankingIndex(const RecordStoreBase& names) : tree_(Order{&names}) {}
+
+    void insert(uint32_t row, int32_t score) { tree_.insert(Key{score, row}); }
+    void erase(uint32_t row, int32_t score) { tree_.erase(Key{score, row}); }
+    void clear() { tree_.clear(); }
+
+    size_t size() const { return tree_.size(); }
+
+    // Место строки в рейтинге, начиная с 0
+    size_t rank(uint32_t row, int32_t score) const { return tree_.order_of_key(Key{score, row}); }
+
+    // До count записей начиная с места offset: O(log n + count)
+    std::vector<Entry> slice(size_t offset, size_t count) const;
+
+private:
+    struct Key {
+        int32_t score;
+        uint32_t row;
+    };
+
+    struct Order {
+        const RecordStoreBase* names;
+
+        bool operator()(const Key& a, const Key& b) const {
+            if (a.score != b.score) {
+                return a.score > b.score;
+            }
+            return names->nickname(a.row) < names->nickname(b.row);
+        }
+    };
+
+    using Tree = __gnu_pbds::tree<Key, __gnu_pbds::null_type, Order,
+                                  __gnu_pbds::rb_tree_tag,
+                                  __gnu_pbds::tree_order_statistics_node_update>;
+
+    Tree tree_;
+};
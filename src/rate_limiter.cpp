@@ -0,0 +1,118 @@
+#include "rate_limiter.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+RateLimiter::Clock::duration secondsToDuration(double seconds) {
+    return std::chrono::duration_cast<RateLimiter::Clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+} // namespace
+
+void RateLimiter::Bucket::refill(Clock::time_point now) {
+    if (now > refilled) {
+        tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - refilled).count());
+        refilled = now;
+    }
+}
+
+RateLimiter::Clock::time_point RateLimiter::Bucket::readyAt(Clock::time_point now) {
+    refill(now);
+    const auto ready = tokens >= 1.0 ? now : now + secondsToDuration((1.0 - tokens) / rate);
+    return std::max(ready, blockedUntil);
+}
+
+RateLimiter::RateLimiter(const Config& config)
+    : config_(config),
+      global_{config.global.burst, config.global.rate, config.global.burst, Clock::now()} {}
+
+const RateProfile& RateLimiter::profile(int64_t chatId) const {
+    return chatId > 0 ? config_.privateChat : config_.groupChat;
+}
+
+RateLimiter::Bucket& RateLimiter::chat(int64_t chatId, Clock::time_point now) {
+    auto it = chats_.find(chatId);
+    if (it == chats_.end()) {
+        const auto& p = profile(chatId);
+        it = chats_.emplace(chatId, Bucket{p.burst, p.rate, p.burst, now}).first;
+    }
+    return it->second;
+}
+
+RateLimiter::Clock::time_point RateLimiter::chatReadyAt(int64_t chatId, Clock::time_point now) {
+    auto it = chats_.find(chatId);
+    return it == chats_.end() ? now : it->second.readyAt(now);
+}
+
+RateLimiter::Clock::time_point RateLimiter::globalReadyAt(Clock::time_point now) {
+    return global_.readyAt(now);
+}
+
+void RateLimiter::acquire(int64_t chatId, Clock::time_point now) {
+    // Токен может уйти в минус, если отправку выдали раньше срока: следующая подождет дольше
+    auto& bucket = chat(chatId, now);
+    bucket.refill(now);
+    bucket.tokens -= 1.0;
+    global_.refill(now);
+    global_.tokens -= 1.0;
+}
+
+void RateLimiter::onSuccess(int64_t chatId) {
+    auto it = chats_.find(chatId);
+    if (it == chats_.end()) {
+        return;
+    }
+    const double full = profile(chatId).rate;
+    it->second.rate = std::min(full, it->second.rate + full * config_.recovery);
+}
+
+void RateLimiter::onRateLimited(int64_t chatId, std::chrono::seconds retryAfter, Clock::time_point now) {
+    auto& bucket = chat(chatId, now);
+    const double full = profile(chatId).rate;
+    bucket.rate = std::max(full * config_.floor, bucket.rate * config_.backoff);
+    bucket.blockedUntil = std::max(bucket.blockedUntil, now + retryAfter);
+    // После паузы - одно сообщение, дальше в сниженном темпе; до конца паузы ведро не пополняется
+    bucket.tokens = std::min(1.0, bucket.burst);
+    bucket.refilled = bucket.blockedUntil;
+}
+
+void RateLimiter::evictIdle(Clock::time_point now) {
+    for (auto it = chats_.begin(); it != chats_.end();) {
+        auto& bucket = it->second;
+        bucket.refill(now);
+        const bool idle = bucket.tokens >= bucket.burst && bucket.blockedUntil <= now
+            && bucket.rate >= profile(it->first).rate;
+        it = idle ? chats_.erase(it) : std::next(it);
+    }
+}
+
+size_t RateLimiter::throttledChats() const {
+    return static_cast<size_t>(std::count_if(chats_.begin(), chats_.end(), [this](const auto& entry) {
+        return entry.second.rate < profile(entry.first).rate;
+    }));
+}
+
+std::optional<std::chrono::seconds> parseRetryAfter(std::string_view description) {
+    constexpr std::string_view kMarker = "retry after";
+    const size_t pos = description.find(kMarker);
+    if (pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+    size_t i = pos + kMarker.size();
+    while (i < description.size() && !std::isdigit(static_cast<unsigned char>(description[i]))) {
+        if (description[i] != ' ' && description[i] != ':') {
+            return std::nullopt;
+        }
+        ++i;
+    }
+    long long seconds = 0;
+    size_t digits = 0;
+    for (; i < description.size() && std::isdigit(static_cast<unsigned char>(description[i])); ++i, ++digits) {
+        seconds = std::min(seconds * 10 + (description[i] - '0'), 86400LL);
+    }
+    if (digits == 0) {
+        return std::nullopt;
+    }
+    return std::chrono::seconds(seconds);
+}
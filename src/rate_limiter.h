@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+// Лимиты Telegram на отправку: ведро токенов с пополнением rate в секунду и
+// емкостью burst
+struct RateProfile {
+    double rate;
+    double burst;
+};
+
+// Многоуровневый ограничитель отправки: общее ведро на бота и ведро на каждый
+// чат. Профиль чата выбирается по знаку id: положительный - личный чат
+// (около 1 сообщения в секунду), отрицательный - группа или канал (около 20 в
+// минуту). Общее ведро - около 30 сообщений в секунду на бота.
+//
+// Ответ 429 блокирует чат на retry_after и вдвое снижает его темп; каждая
+// успешная отправка возвращает часть темпа обратно (AIMD), так что чат сам
+// восстанавливается до профиля. Чат, ведро которого полно и темп которого
+// восстановлен, ничем не отличается от нового и удаляется при evictIdle.
+//
+// Не потокобезопасен: владелец (OutboundScheduler) вызывает его под своим мьютексом.
+class RateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        RateProfile global{30.0, 30.0};
+        RateProfile privateChat{1.0, 1.0};
+        RateProfile groupChat{20.0 / 60.0, 3.0};
+        double backoff = 0.5;   // множитель темпа чата после 429
+        double recovery = 0.1;  // доля темпа профиля, возвращаемая успешной отправкой
+        double floor = 0.05;    // темп чата не опускается ниже этой доли профиля
+    };
+
+    RateLimiter() : RateLimiter(Config{}) {}
+    explicit RateLimiter(const Config& config);
+
+    // Когда чату можно будет отправить следующее сообщение
+    Clock::time_point chatReadyAt(int64_t chatId, Clock::time_point now);
+
+    // Когда в общем ведре появится токен
+    Clock::time_point globalReadyAt(Clock::time_point now);
+
+    // Отправка началась: взять токен чата и общий токен
+    void acquire(int64_t chatId, Clock::time_point now);
+
+    // Отправка прошла: вернуть часть темпа, срезанного после 429
+    void onSuccess(int64_t chatId);
+
+    // Ответ 429: не писать в чат retry_after и снизить его темп
+    void onRateLimited(int64_t chatId, std::chrono::seconds retryAfter, Clock::time_point now);
+
+    // Удалить состояние чатов, которые вернулись к исходному (полное ведро, темп профиля)
+    void evictIdle(Clock::time_point now);
+
+    // Чатов с состоянием (для метрик)
+    size_t chats() const { return chats_.size(); }
+
+    // Чатов со сниженным после 429 темпом (для метрик)
+    size_t throttledChats() const;
+
+private:
+    struct Bucket {
+        double tokens;
+        double rate;
+        double burst;
+        Clock::time_point refilled;
+        Clock::time_point blockedUntil{};
+
+        void refill(Clock::time_point now);
+        Clock::time_point readyAt(Clock::time_point now);
+    };
+
+    Config config_;
+    Bucket global_;
+    std::unordered_map<int64_t, Bucket> chats_;
+
+    const RateProfile& profile(int64_t chatId) const;
+    Bucket& chat(int64_t chatId, Clock::time_point now);
+};
+
+// retry_after из описания ответа 429 ("Too Many Requests: retry after 17").
+// tgbot-cpp не передает поле parameters ответа в TgException, поэтому число
+// берется из описания; nullopt - описание не про 429
+std::optional<std::chrono::seconds> parseRetryAfter(std::string_view description);
@@ -0,0 +1,111 @@
+#include "record_store.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+std::optional<uint32_t> RecordStoreBase::find(std::string_view nickname) const {
+    if (index_.empty()) {
+        return std::nullopt;
+    }
+    const uint32_t entry = index_[slotOf(nickname)];
+    if (entry == 0) {
+        return std::nullopt;
+    }
+    return entry - 1;
+}
+
+uint32_t RecordStoreBase::appendName(std::string_view nickname) {
+    const uint32_t row = static_cast<uint32_t>(names_.size());
+    names_.push_back(intern(*arena_, nickname));
+    live_bytes_ += nickname.size();
+    // Заполнение не больше половины: цепочки пробирования остаются короткими
+    if (names_.size() * 2 > index_.size()) {
+        rehash(std::max<size_t>(16, index_.size() * 2));
+    } else {
+        indexRow(row);
+    }
+    return row;
+}
+
+void RecordStoreBase::swapRemoveName(uint32_t row) {
+    const uint32_t last = static_cast<uint32_t>(names_.size() - 1);
+    unindexSlot(slotOf(names_[row]));
+    live_bytes_ -= names_[row].size();
+    dead_bytes_ += names_[row].size();
+    if (row != last) {
+        // Переезжающей строке меняем номер в индексе на месте
+        index_[slotOf(names_[last])] = row + 1;
+        names_[row] = names_[last];
+    }
+    // Место в арене освобождает compactNames(): на старый string_view могут ссылаться читатели
+    names_.pop_back();
+}
+
+bool RecordStoreBase::compactNames() {
+    // Не меньше блока, чтобы не пересобирать арену из-за пары удалений
+    if (dead_bytes_ < kArenaBlock || dead_bytes_ <= live_bytes_) {
+        return false;
+    }
+    auto arena = std::make_shared<Arena>();
+    for (auto& name : names_) {
+        // Хеш зависит только от содержимого, индекс остается верным
+        name = intern(*arena, name);
+    }
+    arena_ = std::move(arena);
+    dead_bytes_ = 0;
+    return true;
+}
+
+std::string_view RecordStoreBase::intern(Arena& arena, std::string_view nickname) {
+    if (nickname.empty()) {
+        return {};
+    }
+    if (nickname.size() > arena.left) {
+        const size_t block = std::max(kArenaBlock, nickname.size());
+        arena.blocks.push_back(std::make_unique<char[]>(block));
+        arena.next = arena.blocks.back().get();
+        arena.left = block;
+    }
+    char* begin = arena.next;
+    std::memcpy(begin, nickname.data(), nickname.size());
+    arena.next += nickname.size();
+    arena.left -= nickname.size();
+    return std::string_view(begin, nickname.size());
+}
+
+size_t RecordStoreBase::slotOf(std::string_view nickname) const {
+    const size_t mask = index_.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(nickname) & mask;
+    while (index_[slot] != 0 && names_[index_[slot] - 1] != nickname) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void RecordStoreBase::indexRow(uint32_t row) {
+    index_[slotOf(names_[row])] = row + 1;
+}
+
+void RecordStoreBase::rehash(size_t capacity) {
+    index_.assign(capacity, 0);
+    for (uint32_t row = 0; row < names_.size(); ++row) {
+        indexRow(row);
+    }
+}
+
+void RecordStoreBase::unindexSlot(size_t slot) {
+    // Удаление со сдвигом назад: без надгробий поиск не удлиняется со временем
+    const size_t mask = index_.size() - 1;
+    index_[slot] = 0;
+    for (size_t next = (slot + 1) & mask; index_[next] != 0; next = (next + 1) & mask) {
+        const size_t home = std::hash<std::string_view>{}(names_[index_[next] - 1]) & mask;
+        // Запись можно сдвинуть в освободившуюся ячейку, если ее "родная" ячейка
+        // не лежит циклически между освободившейся и текущей
+        const bool movable = slot <= next ? (home <= slot || home > next) : (home <= slot && home > next);
+        if (movable) {
+            index_[slot] = index_[next];
+            index_[next] = 0;
+            slot = next;
+        }
+    }
+}
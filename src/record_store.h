@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "journal_store.h"
+
+// Сколько записей изменила перезагрузка данных из файла
+struct ReloadStats {
+    size_t added = 0;
+    size_t changed = 0;
+    size_t removed = 0;
+
+    bool empty() const { return added == 0 && changed == 0 && removed == 0; }
+};
+
+// Хранилище никнеймов, общее для всех типов записей.
+//
+// Никнеймы лежат в арене из блоков, которые никогда не перемещаются, поэтому
+// string_view из nickname() остается действительным, пока жива арена
+// (nameArena()) - его можно отдавать читателям неизменяемых версий данных
+// вместе с указателем на арену. Удаленные никнеймы остаются в арене, пока их
+// не станет больше живых; тогда compactNames() переносит живые в новую арену,
+// а старая освобождается вместе с последним указателем на нее. Индекс
+// "никнейм -> строка" - плоская хеш-таблица с открытой адресацией.
+// Синхронизация - на стороне владельца.
+class RecordStoreBase {
+public:
+    size_t size() const { return names_.size(); }
+
+    std::optional<uint32_t> find(std::string_view nickname) const;
+
+    std::string_view nickname(uint32_t row) const { return names_[row]; }
+
+    // Арена, в которой лежат никнеймы nickname(): держит их string_view живыми
+    std::shared_ptr<const void> nameArena() const { return arena_; }
+
+    // Переложить живые никнеймы в новую арену, если удаленные занимают больше
+    // места, чем живые. true - никнеймы переехали: string_view, взятые раньше,
+    // действительны, только пока жив прежний nameArena()
+    bool compactNames();
+
+protected:
+    RecordStoreBase() = default;
+
+    // Добавить строку с новым никнеймом (его еще нет в индексе)
+    uint32_t appendName(std::string_view nickname);
+
+    // Убрать строку: последняя строка переезжает на ее место
+    void swapRemoveName(uint32_t row);
+
+private:
+    // Блок арены; место под никнеймы выделяется только в конце последнего блока
+    static constexpr size_t kArenaBlock = 64 * 1024;
+
+    struct Arena {
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char* next = nullptr;
+        size_t left = 0;
+    };
+
+    std::shared_ptr<Arena> arena_ = std::make_shared<Arena>();
+    size_t live_bytes_ = 0; // никнеймы строк
+    size_t dead_bytes_ = 0; // никнеймы удаленных строк, еще занимающие арену
+
+    std::vector<std::string_view> names_; // никнейм каждой строки
+    std::vector<uint32_t> index_;         // номер строки + 1, 0 - пустая ячейка
+
+    static std::string_view intern(Arena& arena, std::string_view nickname);
+    size_t slotOf(std::string_view nickname) const;
+    void indexRow(uint32_t row);
+    void rehash(size_t capacity);
+    void unindexSlot(size_t slot);
+};
+
+// Типизированное хранилище записей "никнейм -> Schema::kFields целых".
+//
+// Поля лежат плотными колонками (struct of arrays): проход по одному полю
+// читает подряд лежащие int32, а запись занимает 4 байта на поле плюс никнейм
+// в арене. JSON используется только на границе сериализации - в журнале
+// JournalStore. Schema задает имена полей:
+//
+//   struct BirthdaySchema {
+//       static constexpr std::array<const char*, 3> kFields{"day", "month", "year"};
+//   };
+template <typename Schema>
+class RecordStore : public RecordStoreBase {
+public:
+    static constexpr size_t kFields = Schema::kFields.size();
+    using Values = std::array<int32_t, kFields>;
+    using Record = std::pair<std::string, Values>;
+
+    // Отличия полного списка записей от текущего состояния
+    struct Diff {
+        std::vector<Record> upserts;      // новые и измененные записи
+        std::vector<std::string> removed; // никнеймы, которых в списке нет
+        size_t added = 0;                 // сколько из upserts - новые
+
+        ReloadStats stats() const { return ReloadStats{added, upserts.size() - added, removed.size()}; }
+    };
+
+    explicit RecordStore(const std::string& json_path)
+        : journal_(json_path, std::vector<std::string>(Schema::kFields.begin(), Schema::kFields.end())) {}
+
+    // Загрузить данные с диска (снапшот + журнал). Вызывается один раз до изменений
+    void load() {
+        journal_.load([this](std::string_view nickname, const int32_t* values) {
+            // Ключи приходят без повторов, поиск по индексу не нужен
+            appendName(nickname);
+            for (size_t f = 0; f < kFields; ++f) {
+                columns_[f].push_back(values[f]);
+            }
+        });
+    }
+
+    int32_t get(uint32_t row, size_t field) const { return columns_[field][row]; }
+
+    Values values(uint32_t row) const {
+        Values result;
+        for (size_t f = 0; f < kFields; ++f) {
+            result[f] = columns_[f][row];
+        }
+        return result;
+    }
+
+    const std::vector<int32_t>& column(size_t field) const { return columns_[field]; }
+
+    // Записать значения и поставить изменение в журнал. Возвращает номер строки
+    uint32_t put(std::string_view nickname, const Values& values) {
+        auto existing = find(nickname);
+        const uint32_t row = existing ? *existing : appendName(nickname);
+        for (size_t f = 0; f < kFields; ++f) {
+            if (existing) {
+                columns_[f][row] = values[f];
+            } else {
+                columns_[f].push_back(values[f]);
+            }
+        }
+
+        nlohmann::json value;
+        for (size_t f = 0; f < kFields; ++f) {
+            value[Schema::kFields[f]] = values[f];
+        }
+        journal_.put(std::string(nickname), value);
+        return row;
+    }
+
+    // Удалить запись. Последняя строка переезжает на место удаленной:
+    // возвращает ее прежний номер, чтобы владелец поправил свои индексы
+    std::optional<uint32_t> erase(std::string_view nickname) {
+        auto row = find(nickname);
+        if (!row) {
+            return std::nullopt;
+        }
+        const uint32_t last = static_cast<uint32_t>(size() - 1);
+        for (auto& column : columns_) {
+            column[*row] = column[last];
+            column.pop_back();
+        }
+        swapRemoveName(*row);
+        journal_.erase(std::string(nickname));
+        return last != *row ? std::optional<uint32_t>(last) : std::nullopt;
+    }
+
+    // Сравнить состояние с полным списком records по ключам. Ничего не
+    // меняет: владелец применяет отличия своими put/erase, обновляя индексы
+    Diff diff(std::vector<Record> records) const {
+        std::sort(records.begin(), records.end(),
+                  [](const Record& a, const Record& b) { return a.first < b.first; });
+        Diff result;
+        for (uint32_t row = 0; row < size(); ++row) {
+            const auto name = nickname(row);
+            auto it = std::lower_bound(records.begin(), records.end(), name,
+                                       [](const Record& record, std::string_view key) { return record.first < key; });
+            if (it == records.end() || it->first != name) {
+                result.removed.emplace_back(name);
+            }
+        }
+        for (auto& record : records) {
+            auto row = find(record.first);
+            if (!row) {
+                ++result.added;
+                result.upserts.push_back(std::move(record));
+            } else if (values(*row) != record.second) {
+                result.upserts.push_back(std::move(record));
+            }
+        }
+        return result;
+    }
+
+    // Записи JSON-файла формата импорта и экспорта
+    // ({"никнейм": {"поле": число, ...}}); отсутствующие поля - 0.
+    // nullopt - файл не читается или в нем не JSON-объект
+    static std::optional<std::vector<Record>> readJson(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return std::nullopt;
+        }
+        auto data = nlohmann::json::parse(file, nullptr, false);
+        if (!data.is_object()) {
+            return std::nullopt;
+        }
+        std::vector<Record> records;
+        records.reserve(data.size());
+        for (auto& [key, value] : data.items()) {
+            Values values{};
+            for (size_t f = 0; f < kFields && value.is_object(); ++f) {
+                auto it = value.find(Schema::kFields[f]);
+                if (it != value.end() && it->is_number_integer()) {
+                    values[f] = it->template get<int32_t>();
+                }
+            }
+            records.emplace_back(key, values);
+        }
+        return records;
+    }
+
+    // Дождаться, пока все изменения окажутся на диске
+    void flush() { journal_.flush(); }
+
+private:
+    JournalStore journal_;
+    std::array<std::vector<int32_t>, kFields> columns_;
+};
@@ -0,0 +1,180 @@
+#include "responses.h"
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <fmt/format.h>
+
+namespace {
+
+// Формы слов после числа в порядке pluralForm: 1 день, 2 дня, 5 дней
+constexpr std::array<std::string_view, 3> kDays{"день", "дня", "дней"};
+constexpr std::array<std::string_view, 3> kYears{"год", "года", "лет"};
+
+// Форма по последним двум цифрам числа: 11-14 - всегда "дней"
+constexpr std::array<uint8_t, 100> kPluralForms = [] {
+    std::array<uint8_t, 100> forms{};
+    for (int n = 0; n < 100; ++n) {
+        const int last = n % 10;
+        if (n >= 11 && n <= 14) {
+            forms[n] = 2;
+        } else if (last == 1) {
+            forms[n] = 0;
+        } else if (last >= 2 && last <= 4) {
+            forms[n] = 1;
+        } else {
+            forms[n] = 2;
+        }
+    }
+    return forms;
+}();
+
+// Буфер потока: после первых ответов память под него больше не выделяется
+fmt::memory_buffer& scratch() {
+    thread_local fmt::memory_buffer buffer;
+    buffer.clear();
+    return buffer;
+}
+
+void append(fmt::memory_buffer& out, std::string_view text) {
+    out.append(text.data(), text.data() + text.size());
+}
+
+template <typename... Args>
+void appendf(fmt::memory_buffer& out, fmt::format_string<Args...> format, Args&&... args) {
+    fmt::format_to(std::back_inserter(out), format, std::forward<Args>(args)...);
+}
+
+std::string finish(const fmt::memory_buffer& out) {
+    return std::string(out.data(), out.size());
+}
+
+// Фрагменты ответов /gay и /grazd по уровням оценки
+constexpr std::array<std::string_view, 5> kGaySuffixes{
+    "% GAY!🏳️‍🌈",
+    "% GAY!🏳️‍🌈🏳️‍🌈",
+    "% GAY!🏳️‍🌈🏳️‍🌈🏳️‍🌈",
+    "% GAY!🏳️‍🌈🏳️‍🌈🏳️‍🌈🏳️‍🌈",
+    "% GAY!🏳️‍🌈🏳️‍🌈🏳️‍🌈🏳️‍🌈🏳️‍🌈 Ты походу тут самый гейский пидарас, снимай штаны",
+};
+
+constexpr std::array<std::string_view, 6> kGrazdSuffixes{
+    "%, ты походу не гражданский! 🪖🪖🪖",
+    "%! 💼",
+    "%! 💼💼",
+    "%! 💼💼💼",
+    "%! 💼💼💼💼",
+    "%! Ты походу сосёшь хуй 💼💼💼💼💼💼💼",
+};
+
+// "15.3 (через 12 дней) - исполнится 35 лет"
+void appendBirthdayDetails(fmt::memory_buffer& out, const BirthdayInfo& info, int days_until, int age) {
+    appendf(out, "{}.{}", info.day, info.month);
+    if (days_until == 0) {
+        append(out, " (СЕГОДНЯ!)");
+    } else if (days_until == 1) {
+        append(out, " (завтра)");
+    } else {
+        appendf(out, " (через {} {})", days_until, kDays[pluralForm(days_until)]);
+    }
+    appendf(out, " - исполнится {} {}", age, kYears[pluralForm(age)]);
+}
+
+} // namespace
+
+int pluralForm(int n) {
+    if (n < 0) {
+        n = -n;
+    }
+    return kPluralForms[n % 100];
+}
+
+std::string renderUpcomingBirthdays(int days, const std::vector<std::pair<BirthdayInfo, int>>& upcoming) {
+    return renderUpcomingBirthdays(days, upcoming, todayAt(localUtcOffset()));
+}
+
+std::string renderUpcomingBirthdays(int days, const std::vector<std::pair<BirthdayInfo, int>>& upcoming,
+                                    const CivilDate& today) {
+    auto& out = scratch();
+    if (upcoming.empty()) {
+        appendf(out, "В ближайшие {} {} дней рождения не найдено.", days, kDays[pluralForm(days)]);
+        return finish(out);
+    }
+
+    appendf(out, "🎂 Дни рождения в ближайшие {} {}:\n\n", days, kDays[pluralForm(days)]);
+
+    // Сегодняшняя дата считается один раз, дальше - только целочисленная арифметика
+    for (const auto& [info, age] : upcoming) {
+        const int days_until = daysUntilBirthday(today, info.day, info.month);
+
+        append(out, "👤 ");
+        append(out, info.nickname);
+        append(out, " - ");
+        appendBirthdayDetails(out, info, days_until, age);
+        append(out, "\n");
+    }
+    return finish(out);
+}
+
+std::string renderBirthdayDetails(const BirthdayInfo& info, const CivilDate& today) {
+    const int days_until = daysUntilBirthday(today, info.day, info.month);
+    auto& out = scratch();
+    appendBirthdayDetails(out, info, days_until, addDays(today, days_until).year - info.year);
+    return finish(out);
+}
+
+std::string renderBirthdayAnnouncement(const std::vector<std::pair<BirthdayInfo, int>>& birthdays) {
+    auto& out = scratch();
+    append(out, "🎉 Сегодня день рождения:\n\n");
+    for (const auto& [info, age] : birthdays) {
+        append(out, "🎂 ");
+        append(out, info.nickname);
+        appendf(out, " - исполняется {} {}\n", age, kYears[pluralForm(age)]);
+    }
+    append(out, "\nПоздравляем! 🥳");
+    return finish(out);
+}
+
+std::string renderGayRoll(std::string_view nickname, int gayness) {
+    const size_t level = gayness <= 25 ? 0 : gayness <= 50 ? 1 : gayness <= 75 ? 2 : gayness <= 99 ? 3 : 4;
+    auto& out = scratch();
+    append(out, nickname);
+    appendf(out, " на {}", gayness);
+    append(out, kGaySuffixes[level]);
+    return finish(out);
+}
+
+std::string renderGrazdRoll(std::string_view nickname, int grazd) {
+    const size_t level = grazd <= 10 ? 0 : grazd <= 25 ? 1 : grazd <= 50 ? 2 : grazd <= 75 ? 3 : grazd <= 99 ? 4 : 5;
+    auto& out = scratch();
+    append(out, nickname);
+    appendf(out, " гражданский на {}", grazd);
+    append(out, kGrazdSuffixes[level]);
+    return finish(out);
+}
+
+std::string renderRatingTop(const std::vector<GayRateInfo>& ratings, bool by_grazd,
+                            const std::optional<OwnRank>& own) {
+    auto& out = scratch();
+    if (ratings.empty()) {
+        append(out, by_grazd ? "Пока здесь гражданских нет, ахуели?\n"
+                             : "Пока здесь педиков нет, но это ненадолго\n");
+        return finish(out);
+    }
+
+    auto score = [by_grazd](const GayRateInfo& info) { return by_grazd ? info.grazd : info.gayness; };
+    append(out, by_grazd ? "👤💼 Главный гражданский - " : "👤🏆🏆🏆 Главный пидарас - ");
+    append(out, ratings[0].nickname);
+    appendf(out, " - {}", score(ratings[0]));
+    append(out, by_grazd ? ", поздравляем! 💼\n" : ", поздравляем! 🏆🏆🏆\n");
+    for (size_t i = 1; i < ratings.size(); ++i) {
+        append(out, "👤 ");
+        append(out, ratings[i].nickname);
+        appendf(out, " - {}\n", score(ratings[i]));
+    }
+    if (own) {
+        append(out, "...\n👤 ");
+        append(out, own->nickname);
+        appendf(out, " - {} ({} место из {})\n", own->score, own->rank + 1, own->total);
+    }
+    return finish(out);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "birthday_manager.h"
+#include "date_utils.h"
+#include "gayrate_manager.h"
+
+// Тексты ответов бота.
+//
+// Ответ собирается в переиспользуемом буфере потока (fmt::memory_buffer) из
+// заранее заготовленных фрагментов; форма слова после числа (день/дня/дней)
+// выбирается по таблице. Единственное выделение памяти на ответ - итоговая строка.
+
+// Форма слова после числа n: 0 - "день", 1 - "дня", 2 - "дней"
+int pluralForm(int n);
+
+// Текст ответа на /dr: список ближайших дней рождения (или сообщение, что их нет).
+// "Сегодня" - по часовому поясу сервера
+std::string renderUpcomingBirthdays(int days, const std::vector<std::pair<BirthdayInfo, int>>& upcoming);
+
+// То же относительно заданной даты "сегодня" - даты в часовом поясе чата
+std::string renderUpcomingBirthdays(int days, const std::vector<std::pair<BirthdayInfo, int>>& upcoming,
+                                    const CivilDate& today);
+
+// Дата дня рождения, сколько до него осталось и сколько исполнится:
+// "15.3 (через 12 дней) - исполнится 35 лет" (строка /dr без никнейма)
+std::string renderBirthdayDetails(const BirthdayInfo& info, const CivilDate& today);
+
+// Текст ежедневного поздравления: все, у кого день рождения сегодня
+std::string renderBirthdayAnnouncement(const std::vector<std::pair<BirthdayInfo, int>>& birthdays);
+
+// Ответы на /gay и /grazd
+std::string renderGayRoll(std::string_view nickname, int gayness);
+std::string renderGrazdRoll(std::string_view nickname, int grazd);
+
+// Место автора команды, если он не попал в показанный топ
+struct OwnRank {
+    std::string_view nickname;
+    int score;
+    size_t rank; // с нуля
+    size_t total;
+};
+
+// Ответ на /gaytop (by_grazd = false) и /grazdtop (by_grazd = true)
+std::string renderRatingTop(const std::vector<GayRateInfo>& ratings, bool by_grazd,
+                            const std::optional<OwnRank>& own);
@@ -0,0 +1,380 @@
+#include "send_pipeline.h"
+#include <algorithm>
+#include <string_view>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <nlohmann/json.hpp>
+#include "rate_limiter.h"
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace ssl = asio::ssl;
+using tcp = asio::ip::tcp;
+
+namespace {
+
+constexpr auto kConnectTimeout = std::chrono::seconds(10);
+constexpr auto kRequestTimeout = std::chrono::seconds(30);
+
+SendResult parseResponse(const http::response<http::string_body>& response) {
+    SendResult result;
+    const int status = static_cast<int>(response.result_int());
+    auto json = nlohmann::json::parse(response.body(), nullptr, false);
+    if (!json.is_object()) {
+        // Не ответ Bot API: страница ошибки прокси или балансировщика
+        result.errorCode = status;
+        result.description = "HTTP " + std::to_string(status) + " " + std::string(response.reason());
+        return result;
+    }
+    result.ok = json.value("ok", false);
+    if (result.ok) {
+        return result;
+    }
+    result.errorCode = json.value("error_code", status);
+    result.description = json.value("description", std::string());
+    if (auto params = json.find("parameters"); params != json.end() && params->is_object()) {
+        if (auto retry = params->find("retry_after"); retry != params->end() && retry->is_number_integer()) {
+            result.retryAfter = std::chrono::seconds(retry->get<int64_t>());
+        }
+    }
+    if (!result.retryAfter) {
+        result.retryAfter = parseRetryAfter(result.description);
+    }
+    return result;
+}
+
+SendResult stoppedResult() {
+    SendResult result;
+    result.description = "send pipeline stopped";
+    result.aborted = true;
+    return result;
+}
+
+// Сервер закрыл простаивающее keep-alive соединение: запрос до него не дошел
+bool isStaleConnection(const beast::error_code& ec) {
+    return ec == http::error::end_of_stream || ec == asio::error::eof
+        || ec == asio::error::connection_reset || ec == asio::error::broken_pipe;
+}
+
+} // namespace
+
+std::optional<ApiEndpoint> parseApiUrl(const std::string& url) {
+    ApiEndpoint endpoint;
+    std::string_view rest = url;
+    if (rest.substr(0, 8) == "https://") {
+        rest.remove_prefix(8);
+    } else if (rest.substr(0, 7) == "http://") {
+        endpoint.tls = false;
+        rest.remove_prefix(7);
+    } else {
+        return std::nullopt;
+    }
+
+    const size_t slash = rest.find('/');
+    const std::string_view authority = rest.substr(0, slash);
+    std::string_view path = slash == std::string_view::npos ? std::string_view() : rest.substr(slash);
+    while (!path.empty() && path.back() == '/') {
+        path.remove_suffix(1);
+    }
+    const size_t colon = authority.rfind(':');
+    if (colon != std::string_view::npos) {
+        endpoint.host = authority.substr(0, colon);
+        endpoint.port = authority.substr(colon + 1);
+    } else {
+        endpoint.host = authority;
+        endpoint.port = endpoint.tls ? "443" : "80";
+    }
+    if (endpoint.host.empty() || endpoint.port.empty()) {
+        return std::nullopt;
+    }
+    endpoint.basePath = path;
+    return endpoint;
+}
+
+// Одно постоянное соединение с сервером Bot API. Работает только в потоке
+// конвейера; живет, пока на него ссылаются конвейер или незавершенная операция
+class SendConnection : public std::enable_shared_from_this<SendConnection> {
+public:
+    explicit SendConnection(SendPipeline& pipeline)
+        : pipeline_(pipeline), resolver_(pipeline.io_) {}
+
+    void send(SendPipeline::Request request) {
+        request_ = std::move(request);
+        retried_ = false;
+        if (connected_) {
+            write();
+        } else {
+            connect();
+        }
+    }
+
+    void close() {
+        resolver_.cancel();
+        if (tls_ || plain_) {
+            beast::error_code ec;
+            lowest().socket().close(ec);
+        }
+        connected_ = false;
+    }
+
+private:
+    SendPipeline& pipeline_;
+    tcp::resolver resolver_;
+    std::optional<beast::tcp_stream> plain_;
+    std::optional<beast::ssl_stream<beast::tcp_stream>> tls_;
+    beast::flat_buffer buffer_;
+    http::request<http::string_body> httpRequest_;
+    http::response<http::string_body> response_;
+    SendPipeline::Request request_;
+    bool connected_ = false;
+    bool reused_ = false;  // соединение уже обслужило запрос и могло быть закрыто сервером по простою
+    bool retried_ = false; // текущий запрос уже повторялся на новом соединении
+
+    beast::tcp_stream& lowest() { return tls_ ? beast::get_lowest_layer(*tls_) : *plain_; }
+
+    template <typename Operation>
+    void withStream(Operation&& operation) {
+        if (tls_) {
+            operation(*tls_);
+        } else {
+            operation(*plain_);
+        }
+    }
+
+    void connect() {
+        const ApiEndpoint& endpoint = *pipeline_.endpoint_;
+        plain_.reset();
+        tls_.reset();
+        buffer_.clear();
+        reused_ = false;
+        if (endpoint.tls) {
+            tls_.emplace(pipeline_.io_, pipeline_.ssl_);
+            // SNI и проверка имени в сертификате
+            if (!SSL_set_tlsext_host_name(tls_->native_handle(), endpoint.host.c_str())) {
+                fail(beast::error_code(static_cast<int>(::ERR_get_error()), asio::error::get_ssl_category()), "tls");
+                return;
+            }
+            tls_->set_verify_callback(ssl::host_name_verification(endpoint.host));
+        } else {
+            plain_.emplace(pipeline_.io_);
+        }
+
+        auto self = shared_from_this();
+        resolver_.async_resolve(endpoint.host, endpoint.port,
+            [self](beast::error_code ec, tcp::resolver::results_type results) {
+                if (ec) {
+                    return self->fail(ec, "resolve");
+                }
+                self->lowest().expires_after(kConnectTimeout);
+                self->lowest().async_connect(results, [self](beast::error_code ec, const tcp::endpoint&) {
+                    if (ec) {
+                        return self->fail(ec, "connect");
+                    }
+                    if (!self->tls_) {
+                        self->connected_ = true;
+                        return self->write();
+                    }
+                    self->lowest().expires_after(kConnectTimeout);
+                    self->tls_->async_handshake(ssl::stream_base::client, [self](beast::error_code ec) {
+                        if (ec) {
+                            return self->fail(ec, "handshake");
+                        }
+                        self->connected_ = true;
+                        self->write();
+                    });
+                });
+            });
+    }
+
+    void write() {
+        httpRequest_ = {};
+        httpRequest_.method(http::verb::post);
+        httpRequest_.target(request_.target);
+        httpRequest_.version(11);
+        httpRequest_.set(http::field::host, pipeline_.endpoint_->host);
+        httpRequest_.set(http::field::user_agent, "birthday_bot");
+        httpRequest_.set(http::field::content_type, "application/json");
+        httpRequest_.keep_alive(true);
+        httpRequest_.body() = request_.body;
+        httpRequest_.prepare_payload();
+        response_ = {};
+
+        lowest().expires_after(kRequestTimeout);
+        auto self = shared_from_this();
+        withStream([&](auto& stream) {
+            http::async_write(stream, httpRequest_, [self](beast::error_code ec, size_t) {
+                if (ec) {
+                    return self->fail(ec, "write");
+                }
+                self->read();
+            });
+        });
+    }
+
+    void read() {
+        auto self = shared_from_this();
+        withStream([&](auto& stream) {
+            http::async_read(stream, buffer_, response_, [self](beast::error_code ec, size_t) {
+                if (ec) {
+                    return self->fail(ec, "read");
+                }
+                self->lowest().expires_never();
+                self->reused_ = true;
+                if (!self->response_.keep_alive()) {
+                    self->close();
+                }
+                self->finish(parseResponse(self->response_));
+            });
+        });
+    }
+
+    void fail(const beast::error_code& ec, const char* stage) {
+        const bool stale = reused_ && !retried_ && isStaleConnection(ec);
+        close();
+        if (stale) {
+            // Повторяем один раз на новом соединении; таймаут не повторяем -
+            // запрос мог дойти до сервера
+            retried_ = true;
+            connect();
+            return;
+        }
+        SendResult result;
+        result.description = std::string(stage) + ": " + ec.message();
+        result.aborted = pipeline_.closing_;
+        finish(std::move(result));
+    }
+
+    void finish(SendResult result) {
+        auto callback = std::move(request_.callback);
+        request_ = {};
+        pipeline_.complete(callback, std::move(result));
+        pipeline_.finished(shared_from_this());
+    }
+};
+
+SendPipeline::SendPipeline(std::string token, const std::string& apiUrl, size_t connections)
+    : token_(std::move(token)), endpoint_(parseApiUrl(apiUrl)),
+      connectionCount_(std::max<size_t>(connections, 1)), ssl_(ssl::context::tls_client) {
+    ssl_.set_default_verify_paths();
+    ssl_.set_verify_mode(ssl::verify_peer);
+}
+
+SendPipeline::~SendPipeline() {
+    stop();
+}
+
+void SendPipeline::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    work_.emplace(asio::make_work_guard(io_));
+    for (size_t i = 0; i < connectionCount_; ++i) {
+        all_.push_back(std::make_shared<SendConnection>(*this));
+    }
+    idle_ = all_;
+    thread_ = std::thread([this]() { io_.run(); });
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+}
+
+void SendPipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    slots_.notify_all();
+    if (!thread_.joinable()) {
+        return;
+    }
+    asio::post(io_, [this]() {
+        closing_ = true;
+        // Незавершенные операции получат operation_aborted и вызовут колбэки
+        for (auto& connection : all_) {
+            connection->close();
+        }
+        while (!queue_.empty()) {
+            auto callback = std::move(queue_.front().callback);
+            queue_.pop_front();
+            complete(callback, stoppedResult());
+        }
+    });
+    work_.reset();
+    thread_.join();
+    all_.clear();
+    idle_.clear();
+}
+
+bool SendPipeline::waitForSlot() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    slots_.wait(lock, [this] { return stopped_ || inFlight_ < connectionCount_; });
+    return !stopped_;
+}
+
+void SendPipeline::drain(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    slots_.wait_for(lock, timeout, [this] { return inFlight_ == 0; });
+}
+
+size_t SendPipeline::inFlight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inFlight_;
+}
+
+void SendPipeline::sendMessage(int64_t chatId, const std::string& text, Callback callback) {
+    if (!endpoint_) {
+        SendResult result;
+        result.description = "invalid Bot API URL";
+        callback(std::move(result));
+        return;
+    }
+    const nlohmann::json body{{"chat_id", chatId}, {"text", text}};
+    Request request{endpoint_->basePath + "/bot" + token_ + "/sendMessage", body.dump(), std::move(callback)};
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopped_ || !running_) {
+        lock.unlock();
+        request.callback(stoppedResult());
+        return;
+    }
+    ++inFlight_;
+    // Под мьютексом: stop() не успеет снять work guard до этой задачи
+    asio::post(io_, [this, request = std::move(request)]() mutable {
+        queue_.push_back(std::move(request));
+        dispatch();
+    });
+}
+
+void SendPipeline::dispatch() {
+    while (!queue_.empty() && !idle_.empty()) {
+        auto request = std::move(queue_.front());
+        queue_.pop_front();
+        if (closing_) {
+            complete(request.callback, stoppedResult());
+            continue;
+        }
+        auto connection = std::move(idle_.back());
+        idle_.pop_back();
+        connection->send(std::move(request));
+    }
+}
+
+void SendPipeline::finished(const std::shared_ptr<SendConnection>& connection) {
+    idle_.push_back(connection);
+    dispatch();
+}
+
+void SendPipeline::complete(const Callback& callback, SendResult result) {
+    if (callback) {
+        callback(std::move(result));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --inFlight_;
+    }
+    slots_.notify_all();
+}
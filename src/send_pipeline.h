@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ssl/context.hpp>
+
+// Результат вызова Bot API
+struct SendResult {
+    bool ok = false;
+    int errorCode = 0;       // error_code из ответа Telegram (или HTTP-статус); 0 - ответа нет
+    std::string description; // описание ошибки Telegram или ошибки сети
+    std::optional<std::chrono::seconds> retryAfter; // parameters.retry_after из ответа 429
+    bool aborted = false;    // конвейер остановлен до ответа: неизвестно, дошло ли сообщение
+};
+
+// Адрес сервера Bot API: "https://api.telegram.org", "http://127.0.0.1:8081/prefix"
+struct ApiEndpoint {
+    bool tls = true;
+    std::string host;
+    std::string port;
+    std::string basePath; // без завершающего '/'
+};
+
+std::optional<ApiEndpoint> parseApiUrl(const std::string& url);
+
+class SendConnection;
+
+// Асинхронный конвейер вызовов sendMessage.
+//
+// Держит несколько постоянных keep-alive соединений (TLS для https://) с
+// сервером Bot API на одном потоке Boost.Asio. Каждое соединение ведет один
+// запрос за раз, поэтому одновременно в полете до connections() вызовов - в
+// разные чаты: порядок внутри чата обеспечивает OutboundScheduler, который не
+// выдает сообщение чата, пока предыдущее не завершено. Соединение, закрытое
+// сервером между запросами, переоткрывается, и запрос повторяется один раз.
+// Колбэк завершения вызывается в потоке конвейера - он должен быть коротким.
+class SendPipeline {
+public:
+    using Callback = std::function<void(SendResult)>;
+
+    SendPipeline(std::string token, const std::string& apiUrl, size_t connections);
+    ~SendPipeline();
+
+    SendPipeline(const SendPipeline&) = delete;
+    SendPipeline& operator=(const SendPipeline&) = delete;
+
+    void start();
+
+    // Закрыть соединения; незавершенные вызовы получают ошибку
+    void stop();
+
+    // Дождаться свободного соединения. false - конвейер остановлен
+    bool waitForSlot();
+
+    // Дождаться завершения вызовов в полете, но не дольше timeout
+    void drain(std::chrono::milliseconds timeout);
+
+    void sendMessage(int64_t chatId, const std::string& text, Callback callback);
+
+    size_t inFlight() const;
+    size_t connections() const { return connectionCount_; }
+
+private:
+    friend class SendConnection;
+
+    struct Request {
+        std::string target;
+        std::string body;
+        Callback callback;
+    };
+
+    std::string token_;
+    std::optional<ApiEndpoint> endpoint_;
+    size_t connectionCount_;
+
+    boost::asio::io_context io_;
+    boost::asio::ssl::context ssl_;
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_;
+    std::thread thread_;
+
+    // Только в потоке конвейера
+    std::vector<std::shared_ptr<SendConnection>> idle_;
+    std::vector<std::shared_ptr<SendConnection>> all_;
+    std::deque<Request> queue_;
+    bool closing_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable slots_;
+    size_t inFlight_ = 0;
+    bool running_ = false;
+    bool stopped_ = false;
+
+    void dispatch();
+    void finished(const std::shared_ptr<SendConnection>& connection);
+    void complete(const Callback& callback, SendResult result);
+};
@@ -0,0 +1,164 @@
+#include "snapshot_format.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[8] = {'B', 'D', 'A', 'Y', 'S', 'N', 'A', 'P'};
+constexpr uint32_t kMaxFields = 64;
+
+static_assert(sizeof(SnapshotHeader) == 32, "snapshot header layout changed");
+
+} // namespace
+
+SnapshotEncoder::SnapshotEncoder(const std::vector<std::string>& fields) {
+    fields_.reserve(fields.size());
+    for (const auto& field : fields) {
+        // Имя обрезается до размера ячейки, последний байт - всегда '\0'
+        fields_.push_back(field.substr(0, kSnapshotFieldName - 1));
+    }
+}
+
+void SnapshotEncoder::add(std::string_view key, const int32_t* values) {
+    records_.push_back(static_cast<uint32_t>(strings_.size()));
+    records_.push_back(static_cast<uint32_t>(key.size()));
+    for (size_t f = 0; f < fields_.size(); ++f) {
+        uint32_t raw;
+        std::memcpy(&raw, &values[f], sizeof(raw));
+        records_.push_back(raw);
+    }
+    strings_.append(key);
+    ++count_;
+}
+
+std::string SnapshotEncoder::finish() const {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSnapshotVersion;
+    header.field_count = static_cast<uint32_t>(fields_.size());
+    header.record_count = count_;
+    header.strings_bytes = strings_.size();
+
+    std::string data;
+    data.reserve(sizeof(header) + fields_.size() * kSnapshotFieldName
+                 + records_.size() * sizeof(uint32_t) + strings_.size());
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& field : fields_) {
+        char name[kSnapshotFieldName] = {};
+        std::memcpy(name, field.data(), field.size());
+        data.append(name, sizeof(name));
+    }
+    data.append(reinterpret_cast<const char*>(records_.data()), records_.size() * sizeof(uint32_t));
+    data.append(strings_);
+    return data;
+}
+
+MappedSnapshot::~MappedSnapshot() {
+    close();
+}
+
+void MappedSnapshot::close() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    count_ = 0;
+    records_ = nullptr;
+    strings_ = nullptr;
+    fields_.clear();
+}
+
+SnapshotStatus MappedSnapshot::fail(const std::string& reason) {
+    close();
+    error_ = reason;
+    return SnapshotStatus::Corrupt;
+}
+
+SnapshotStatus MappedSnapshot::open(const std::string& path) {
+    close();
+    error_.clear();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return SnapshotStatus::Missing;
+        }
+        return fail(std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return fail(std::strerror(errno));
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        return fail("file is too short");
+    }
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // отображение держит файл само
+    if (mapped == MAP_FAILED) {
+        return fail(std::strerror(errno));
+    }
+    data_ = static_cast<const char*>(mapped);
+    size_ = size;
+
+    SnapshotHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        return fail("bad magic");
+    }
+    if (header.version != kSnapshotVersion) {
+        return fail("unsupported version " + std::to_string(header.version));
+    }
+    if (header.field_count == 0 || header.field_count > kMaxFields) {
+        return fail("bad field count");
+    }
+
+    // Размер файла должен сойтись точно. Части вычитаются из размера по одной,
+    // а не складываются: сумма значений из заголовка может переполниться
+    const uint64_t stride = 2 + header.field_count;
+    const uint64_t names_bytes = uint64_t{header.field_count} * kSnapshotFieldName;
+    if (names_bytes > size - sizeof(header)) {
+        return fail("field names exceed file size");
+    }
+    const uint64_t max_records = (size - sizeof(header) - names_bytes) / (stride * sizeof(uint32_t));
+    if (header.record_count > max_records) {
+        return fail("record count exceeds file size");
+    }
+    const uint64_t records_bytes = header.record_count * stride * sizeof(uint32_t);
+    const uint64_t fixed_bytes = sizeof(header) + names_bytes + records_bytes;
+    if (header.strings_bytes != size - fixed_bytes) {
+        return fail("size mismatch");
+    }
+
+    const char* names = data_ + sizeof(header);
+    for (uint32_t f = 0; f < header.field_count; ++f) {
+        const char* name = names + f * kSnapshotFieldName;
+        fields_.emplace_back(name, strnlen(name, kSnapshotFieldName - 1));
+    }
+    records_ = reinterpret_cast<const uint32_t*>(names + names_bytes);
+    strings_ = names + names_bytes + records_bytes;
+    stride_ = static_cast<size_t>(stride);
+    count_ = static_cast<size_t>(header.record_count);
+
+    // Один проход по записям: дальше key() и values() не проверяют границы
+    std::string_view previous;
+    for (size_t i = 0; i < count_; ++i) {
+        const uint32_t* record = recordAt(i);
+        if (uint64_t{record[0]} + record[1] > header.strings_bytes) {
+            return fail("key out of bounds in record " + std::to_string(i));
+        }
+        const std::string_view current = key(i);
+        if (i > 0 && !(previous < current)) {
+            return fail("keys are not sorted at record " + std::to_string(i));
+        }
+        previous = current;
+    }
+    return SnapshotStatus::Ok;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Бинарный снапшот хранилища "ключ -> набор int32-полей".
+//
+// Файл читается через mmap прямо на месте, без разбора и без выделения памяти
+// на каждое поле. Порядок байт - родной для машины (little-endian на x86/ARM);
+// файл с другой машины не пройдет проверку заголовка. Раскладка, все смещения
+// кратны 4:
+//
+//   SnapshotHeader
+//   char field_names[field_count][kSnapshotFieldName]  (имена полей, '\0' в конце)
+//   records[record_count]: uint32 key_offset, uint32 key_size, int32 values[field_count]
+//   char strings[strings_bytes]                         (ключи подряд, без '\0')
+//
+// Записи упорядочены по ключу, поэтому снапшот и журнал сливаются за один проход.
+
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr size_t kSnapshotFieldName = 16;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t field_count;
+    uint64_t record_count;
+    uint64_t strings_bytes;
+};
+
+// Сборка снапшота в памяти. Ключи добавляются строго по возрастанию
+class SnapshotEncoder {
+public:
+    explicit SnapshotEncoder(const std::vector<std::string>& fields);
+
+    void add(std::string_view key, const int32_t* values);
+
+    // Готовое содержимое файла
+    std::string finish() const;
+
+private:
+    std::vector<std::string> fields_;
+    std::vector<uint32_t> records_;
+    std::string strings_;
+    uint64_t count_ = 0;
+};
+
+enum class SnapshotStatus {
+    Ok,
+    Missing,
+    Corrupt,
+};
+
+// Снапшот, отображенный в память только для чтения
+class MappedSnapshot {
+public:
+    MappedSnapshot() = default;
+    ~MappedSnapshot();
+
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    // Отобразить файл и проверить заголовок и границы всех записей
+    SnapshotStatus open(const std::string& path);
+    void close();
+
+    size_t size() const { return count_; }
+    size_t bytes() const { return size_; }
+    const std::vector<std::string>& fields() const { return fields_; }
+    const std::string& error() const { return error_; }
+
+    std::string_view key(size_t i) const {
+        const uint32_t* record = recordAt(i);
+        return std::string_view(strings_ + record[0], record[1]);
+    }
+
+    const int32_t* values(size_t i) const {
+        return reinterpret_cast<const int32_t*>(recordAt(i) + 2);
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t count_ = 0;
+    size_t stride_ = 0; // длина записи в uint32
+    const uint32_t* records_ = nullptr;
+    const char* strings_ = nullptr;
+    std::vector<std::string> fields_;
+    std::string error_;
+
+    const uint32_t* recordAt(size_t i) const { return records_ + i * stride_; }
+    SnapshotStatus fail(const std::string& reason);
+};
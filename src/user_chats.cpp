@@ -0,0 +1,30 @@
+#include "user_chats.h"
+#include <algorithm>
+
+void UserChats::remember(int64_t userId, int64_t chatId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& chats = chats_[userId];
+    if (!chats.empty() && chats.front() == chatId) {
+        return; // обычный случай: пользователь пишет в тот же чат
+    }
+    auto it = std::find(chats.begin(), chats.end(), chatId);
+    if (it == chats.end()) {
+        if (chats.size() == kMaxChatsPerUser) {
+            chats.pop_back();
+        }
+        chats.insert(chats.begin(), chatId);
+    } else {
+        std::rotate(chats.begin(), it, it + 1);
+    }
+}
+
+std::vector<int64_t> UserChats::chatsOf(int64_t userId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = chats_.find(userId);
+    return it == chats_.end() ? std::vector<int64_t>() : it->second;
+}
+
+size_t UserChats::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chats_.size();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Чаты, в которых пользователь писал боту с момента запуска. Инлайн-запрос
+// приходит без чата, и ответ на него ограничен данными этих чатов: чужой чат
+// в подсказки не попадает. Недавние чаты идут первыми.
+class UserChats {
+public:
+    // Сколько последних чатов помнится на пользователя
+    static constexpr size_t kMaxChatsPerUser = 16;
+
+    void remember(int64_t userId, int64_t chatId);
+
+    std::vector<int64_t> chatsOf(int64_t userId) const;
+
+    // Пользователей с известными чатами (для метрик)
+    size_t size() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<int64_t, std::vector<int64_t>> chats_;
+};
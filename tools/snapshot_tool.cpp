@@ -0,0 +1,170 @@
+// Конвертер хранилищ бота между JSON и бинарным снапшотом.
+//
+//   birthday_snapshot import <файл.json>...   JSON (и журналы старых версий) -> <файл>.snap
+//   birthday_snapshot export <файл.json>...   снапшот + журнал -> <файл>.json
+//
+// Бот импортирует JSON и сам при загрузке чата, конвертер нужен, чтобы сделать
+// это заранее (например, для всех чатов: birthday_snapshot import birthdays/*.json)
+// или чтобы выгрузить данные для правки. import запускать при остановленном
+// боте; export только читает файлы хранилища и безопасен при работающем боте.
+//
+// Выгруженный JSON получает время изменения самого нового из прочитанных
+// файлов хранилища, а не текущее: бот применяет JSON, только если он новее
+// данных чата, поэтому выгрузка сама по себе не откатит изменения, пришедшие
+// во время нее. Применяется только выгрузка, сохраненная после правки руками.
+
+#include "journal_store.h"
+#include "snapshot_format.h"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+// Поля схемы - все целочисленные поля значений JSON
+bool fieldsFromJson(const std::string& path, std::vector<std::string>& fields) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << path << ": cannot open" << std::endl;
+        return false;
+    }
+    nlohmann::json data;
+    try {
+        file >> data;
+    } catch (const std::exception& e) {
+        std::cerr << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    std::set<std::string> names;
+    for (auto& [key, value] : data.items()) {
+        if (!value.is_object()) continue;
+        for (auto& [name, field] : value.items()) {
+            if (field.is_number_integer()) names.insert(name);
+        }
+    }
+    fields.assign(names.begin(), names.end());
+    return true;
+}
+
+// Поля по записям журнала - для хранилища, у которого еще не было компакции
+std::vector<std::string> fieldsFromJournal(const std::string& path) {
+    std::set<std::string> names;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        auto record = nlohmann::json::parse(line, nullptr, false);
+        if (record.is_discarded() || !record.contains("v") || !record["v"].is_object()) continue;
+        for (auto& [name, field] : record["v"].items()) {
+            if (field.is_number_integer()) names.insert(name);
+        }
+    }
+    return std::vector<std::string>(names.begin(), names.end());
+}
+
+int importJson(const std::string& path) {
+    std::vector<std::string> fields;
+    if (!fieldsFromJson(path, fields)) {
+        return 1;
+    }
+    if (fields.empty()) {
+        std::cerr << path << ": no integer fields, nothing to import" << std::endl;
+        return 1;
+    }
+    JournalStore store(path, fields);
+    size_t records = 0;
+    store.load([&records](std::string_view, const int32_t*) { ++records; });
+    std::cout << path << ": " << records << " records in " << storeBasePath(path) << ".snap" << std::endl;
+    return 0;
+}
+
+int exportJson(const std::string& path) {
+    const std::string snapshot_path = storeBasePath(path) + ".snap";
+    std::vector<std::string> fields;
+    MappedSnapshot snapshot;
+    switch (snapshot.open(snapshot_path)) {
+    case SnapshotStatus::Ok:
+        fields = snapshot.fields();
+        snapshot.close();
+        break;
+    case SnapshotStatus::Missing:
+        for (const auto& journal : {storeBasePath(path) + ".journal.compacting", storeBasePath(path) + ".journal"}) {
+            for (auto& name : fieldsFromJournal(journal)) {
+                if (std::find(fields.begin(), fields.end(), name) == fields.end()) {
+                    fields.push_back(name);
+                }
+            }
+        }
+        std::sort(fields.begin(), fields.end());
+        break;
+    case SnapshotStatus::Corrupt:
+        std::cerr << snapshot_path << ": " << snapshot.error() << std::endl;
+        return 1;
+    }
+    if (fields.empty()) {
+        std::cerr << path << ": no data to export" << std::endl;
+        return 1;
+    }
+
+    nlohmann::json data = nlohmann::json::object();
+    struct timespec store_mtime{};
+    const bool read = JournalStore::read(path, fields, [&](std::string_view key, const int32_t* values) {
+        auto& value = data[std::string(key)];
+        for (size_t f = 0; f < fields.size(); ++f) {
+            value[fields[f]] = values[f];
+        }
+    }, &store_mtime);
+    if (!read) {
+        return 1;
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << tmp_path << ": cannot write" << std::endl;
+            return 1;
+        }
+        file << data.dump(4) << std::endl;
+    }
+    // До rename: наблюдатель бота видит файл уже с итоговым временем
+    const struct timespec times[2] = {{0, UTIME_OMIT}, store_mtime};
+    if (::utimensat(AT_FDCWD, tmp_path.c_str(), times, 0) != 0) {
+        std::cerr << tmp_path << ": cannot set modification time" << std::endl;
+        std::remove(tmp_path.c_str());
+        return 1;
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << path << ": cannot replace" << std::endl;
+        return 1;
+    }
+    std::cout << path << ": " << data.size() << " records exported" << std::endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " import|export <file.json>..." << std::endl;
+        return 2;
+    }
+    const std::string command = argv[1];
+    if (command != "import" && command != "export") {
+        std::cerr << "Unknown command: " << command << std::endl;
+        return 2;
+    }
+
+    int status = 0;
+    for (int i = 2; i < argc; ++i) {
+        const int result = command == "import" ? importJson(argv[i]) : exportJson(argv[i]);
+        status = status ? status : result;
+    }
+    return status;
+}